@@ -0,0 +1,347 @@
+/*
+*   Description:            Benchmarks of stringType against std::string and std::string_view (make bench).
+*                           Construction, copy, move, append chains, a + b + c, find and hashing, for
+*                           lengths from 1 B to 16 MB, with each representation mode of stringType:
+*                           plain (inline up to 23 characters, new[] above), cow (share()d buffers)
+*                           and arena (std::pmr::monotonic_buffer_resource).
+*   Output:                 One row per op, implementation and length: ns/op, MB/s and allocations/op
+*                           (operator new is counted). --save writes the rows, --baseline compares with
+*                           saved ones and flags allocations that change (a mode that stopped or started
+*                           allocating, exact) and ops slower than the tolerance (timings, noisy).
+*                           More allocations make the exit code 1, slower ops too with --fail-slower.
+*   Usage:                  stringTypeBench [--quick] [--save FILE] [--baseline FILE] [--tolerance 0.25] [--fail-slower]
+*/
+#include "stringType.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <memory_resource>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static size_t nAllocations = 0;
+
+void* operator new(size_t nBytes)
+{
+    ++nAllocations;
+    void* p = malloc(nBytes != 0 ? nBytes : 1);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+namespace
+{
+    // the compiler must assume the value is read, so the op producing it stays
+    template <typename T>
+    void keep(const T& value)
+    {
+        asm volatile("" : : "r"(&value) : "memory");
+    }
+
+    struct Row
+    {
+        std::string strOp;
+        std::string strImpl;
+        size_t nLength;
+        double nNsPerOp;
+        double nAllocsPerOp;
+    };
+
+    struct Options
+    {
+        bool bQuick = false;
+        const char* pSave = nullptr;
+        const char* pBaseline = nullptr;
+        double nTolerance = 0.25;
+        bool bFailSlower = false;
+    };
+
+    class Bench
+    {
+        public:
+            explicit Bench(const Options& options) : _options(options)
+            { }
+
+            // batches doubling until one takes long enough, then the best of 3 batches that size is reported
+            void run(const char* pOp, const char* pImpl, size_t nLength, const std::function<void()>& op)
+            {
+                double nMinNs = _options.bQuick ? 2e6 : 20e6;
+                op();   // warm up: caches, lazy tables, kernel selection
+                size_t nOps = 1;
+                size_t nAllocs = 0;
+                double nNs = _batch(op, nOps, nAllocs);
+                while (nNs < nMinNs && nOps < (size_t(1) << 26))
+                {
+                    nOps *= 2;
+                    nNs = _batch(op, nOps, nAllocs);
+                }
+                for (int i = 0; i < 2; ++i)
+                {
+                    size_t nIgnored;
+                    double nAgain = _batch(op, nOps, nIgnored);
+                    nNs = nAgain < nNs ? nAgain : nNs;
+                }
+
+                Row row{pOp, pImpl, nLength, nNs / nOps, double(nAllocs) / nOps};
+                printf("%-12s %-18s %10zu %14.1f %12.1f %10.2f\n", pOp, pImpl, nLength,
+                       row.nNsPerOp, nLength * 1e3 / row.nNsPerOp, row.nAllocsPerOp);
+                _rows.push_back(row);
+            }
+
+            const std::vector<Row>& rows() const
+            {
+                return _rows;
+            }
+
+        protected:
+            // ns taken by nOps ops, nAllocs the operator new calls they made
+            static double _batch(const std::function<void()>& op, size_t nOps, size_t& nAllocs)
+            {
+                size_t nAllocsBefore = nAllocations;
+                auto start = std::chrono::steady_clock::now();
+                for (size_t i = 0; i < nOps; ++i)
+                {
+                    op();
+                }
+                double nNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+                nAllocs = nAllocations - nAllocsBefore;
+                return nNs;
+            }
+
+            Options _options;
+            std::vector<Row> _rows;
+    };
+
+    std::string key(const Row& row)
+    {
+        return row.strOp + " " + row.strImpl + " " + std::to_string(row.nLength);
+    }
+
+    void save(const std::vector<Row>& rows, const char* pPath)
+    {
+        std::ofstream out(pPath);
+        for (const Row& row : rows)
+        {
+            out << key(row) << " " << row.nNsPerOp << " " << row.nAllocsPerOp << "\n";
+        }
+    }
+
+    // number of regressions against the rows saved in pPath
+    int compare(const std::vector<Row>& rows, const char* pPath, const Options& options)
+    {
+        double nTolerance = options.nTolerance;
+        std::ifstream in(pPath);
+        if (!in)
+        {
+            fprintf(stderr, "no baseline %s\n", pPath);
+            return 0;
+        }
+        std::vector<Row> baseline;
+        std::string strLine;
+        while (std::getline(in, strLine))
+        {
+            std::istringstream fields(strLine);
+            Row row;
+            if (fields >> row.strOp >> row.strImpl >> row.nLength >> row.nNsPerOp >> row.nAllocsPerOp)
+            {
+                baseline.push_back(row);
+            }
+        }
+
+        printf("\nagainst %s (tolerance %.0f%%)\n", pPath, nTolerance * 100);
+        int nRegressions = 0;
+        for (const Row& row : rows)
+        {
+            for (const Row& base : baseline)
+            {
+                if (key(base) != key(row))
+                {
+                    continue;
+                }
+                // allocations per op are exact: a change means a representation mode changed
+                bool bMoreAllocs = row.nAllocsPerOp > base.nAllocsPerOp + 0.01;
+                bool bFewerAllocs = row.nAllocsPerOp < base.nAllocsPerOp - 0.01;
+                // a few ns are below the timer and scheduling noise, whatever the tolerance
+                bool bSlower = row.nNsPerOp > base.nNsPerOp * (1 + nTolerance) && row.nNsPerOp - base.nNsPerOp > 5;
+                bool bRegression = bMoreAllocs || (bSlower && options.bFailSlower);
+                if (bRegression)
+                {
+                    ++nRegressions;
+                }
+                if (bMoreAllocs || bFewerAllocs || bSlower)
+                {
+                    printf("%-10s %-40s %10.1f -> %10.1f ns/op %6.2f -> %6.2f allocs/op\n",
+                           bRegression ? "REGRESSION" : (bSlower ? "slower" : "changed"), key(row).c_str(),
+                           base.nNsPerOp, row.nNsPerOp, base.nAllocsPerOp, row.nAllocsPerOp);
+                }
+            }
+        }
+        printf("%d regression(s)\n", nRegressions);
+        return nRegressions;
+    }
+
+    void benchLength(Bench& bench, const std::string& strSource, size_t nLength)
+    {
+        const char* pSource = strSource.data();
+        stringTypeView strView(pSource, nLength);
+        std::string_view stdView(pSource, nLength);
+
+        // fixed buffers, no upstream allocation: one for the strings kept through the ops, one for
+        // temporaries (release() after each op goes back to its start, appends growing use up to 4 * nLength)
+        std::vector<char> arenaBuffer(6 * nLength + 8192);
+        std::pmr::monotonic_buffer_resource arenaKept(arenaBuffer.data(), 2 * nLength + 4096);
+        std::pmr::monotonic_buffer_resource arena(arenaBuffer.data() + 2 * nLength + 4096, 4 * nLength + 4096);
+
+        bench.run("construct", "std::string", nLength, [&] { std::string s(pSource, nLength); keep(s); });
+        bench.run("construct", "stringType", nLength, [&] { stringType s(pSource, nLength); keep(s); });
+        bench.run("construct", "stringType/cow", nLength, [&] { stringType s = stringType::shared(strView); keep(s); });
+        bench.run("construct", "stringType/arena", nLength, [&] { { stringType s(strView, &arena); keep(s); } arena.release(); });
+
+        std::string stdString(pSource, nLength);
+        stringType strPlain(pSource, nLength);
+        stringType strShared = stringType::shared(strView);
+        stringType strArena(strView, &arenaKept);
+
+        bench.run("copy", "std::string", nLength, [&] { std::string s(stdString); keep(s); });
+        bench.run("copy", "stringType", nLength, [&] { stringType s(strPlain); keep(s); });
+        bench.run("copy", "stringType/cow", nLength, [&] { stringType s(strShared); keep(s); });
+        // copies of arena strings go to new[] (like std::pmr strings), so this one copies into the arena
+        bench.run("copy", "stringType/arena", nLength, [&] { { stringType s(strArena.view(), &arena); keep(s); } arena.release(); });
+
+        bench.run("move", "std::string", nLength, [&] { std::string s(std::move(stdString)); stdString = std::move(s); keep(stdString); });
+        bench.run("move", "stringType", nLength, [&] { stringType s(std::move(strPlain)); strPlain = std::move(s); keep(strPlain); });
+        bench.run("move", "stringType/cow", nLength, [&] { stringType s(std::move(strShared)); strShared = std::move(s); keep(strShared); });
+        bench.run("move", "stringType/arena", nLength, [&] { stringType s(std::move(strArena)); strArena = std::move(s); keep(strArena); });
+
+        // 8 appends (fewer for tiny strings) building nLength characters from an empty string
+        size_t nPiece = nLength >= 8 ? nLength / 8 : 1;
+        size_t nPieces = nLength / nPiece;
+        bench.run("append", "std::string", nLength, [&]
+        {
+            std::string s;
+            for (size_t i = 0; i < nPieces; ++i)
+            {
+                s.append(pSource + i * nPiece, nPiece);
+            }
+            keep(s);
+        });
+        bench.run("append", "stringType", nLength, [&]
+        {
+            stringType s;
+            for (size_t i = 0; i < nPieces; ++i)
+            {
+                s.append(stringTypeView(pSource + i * nPiece, nPiece));
+            }
+            keep(s);
+        });
+        bench.run("append", "stringType/arena", nLength, [&]
+        {
+            {
+                stringType s(&arena);
+                for (size_t i = 0; i < nPieces; ++i)
+                {
+                    s.append(stringTypeView(pSource + i * nPiece, nPiece));
+                }
+                keep(s);
+            }
+            arena.release();
+        });
+
+        // a + b + c in thirds
+        size_t nThird = nLength / 3;
+        std::string stdA(pSource, nThird), stdB(pSource + nThird, nThird), stdC(pSource + 2 * nThird, nLength - 2 * nThird);
+        stringType strA(pSource, nThird), strB(pSource + nThird, nThird), strC(pSource + 2 * nThird, nLength - 2 * nThird);
+        bench.run("plus", "std::string", nLength, [&] { std::string s = stdA + stdB + stdC; keep(s); });
+        bench.run("plus", "stringType", nLength, [&] { stringType s = strA + strB + strC; keep(s); });
+
+        // a character that is not there and a needle at the very end: both scan everything
+        const char* pNeedle = pSource + nLength - (nLength < 8 ? nLength : 8);
+        stringTypeView strNeedle(pNeedle, pSource + nLength - pNeedle);
+        std::string_view stdNeedle(pNeedle, pSource + nLength - pNeedle);
+        bench.run("find_char", "std::string_view", nLength, [&] { size_t n = stdView.find('\x01'); keep(n); });
+        bench.run("find_char", "stringTypeView", nLength, [&] { size_t n = strView.find('\x01'); keep(n); });
+        bench.run("find_str", "std::string_view", nLength, [&] { size_t n = stdView.find(stdNeedle); keep(n); });
+        bench.run("find_str", "stringTypeView", nLength, [&] { size_t n = strView.find(strNeedle); keep(n); });
+
+        bench.run("hash", "std::string_view", nLength, [&] { size_t n = std::hash<std::string_view>()(stdView); keep(n); });
+        bench.run("hash", "stringTypeView", nLength, [&] { uint64_t n = strView.hash(); keep(n); });
+        // long strings cache it: this is the cost of asking again
+        bench.run("hash", "stringType", nLength, [&] { uint64_t n = strPlain.hash(); keep(n); });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string strArg = argv[i];
+        if (strArg == "--quick")
+        {
+            options.bQuick = true;
+        }
+        else if (strArg == "--save" && i + 1 < argc)
+        {
+            options.pSave = argv[++i];
+        }
+        else if (strArg == "--baseline" && i + 1 < argc)
+        {
+            options.pBaseline = argv[++i];
+        }
+        else if (strArg == "--tolerance" && i + 1 < argc)
+        {
+            options.nTolerance = atof(argv[++i]);
+        }
+        else if (strArg == "--fail-slower")
+        {
+            options.bFailSlower = true;
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--quick] [--save FILE] [--baseline FILE] [--tolerance 0.25] [--fail-slower]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    static const size_t lengths[] = {1, 8, 15, 16, 23, 24, 64, 256, 4096, 65536, size_t(1) << 20, size_t(16) << 20};
+    std::string strSource(lengths[sizeof(lengths) / sizeof(lengths[0]) - 1], '\0');
+    for (size_t i = 0; i < strSource.size(); ++i)
+    {
+        strSource[i] = static_cast<char>('a' + (i * 7) % 26);
+    }
+
+    printf("simd %s\n", stringTypeSimdLevel());
+    printf("%-12s %-18s %10s %14s %12s %10s\n", "op", "impl", "length", "ns/op", "MB/s", "allocs/op");
+    Bench bench(options);
+    for (size_t nLength : lengths)
+    {
+        benchLength(bench, strSource, nLength);
+    }
+
+    if (options.pSave != nullptr)
+    {
+        save(bench.rows(), options.pSave);
+    }
+    if (options.pBaseline != nullptr && compare(bench.rows(), options.pBaseline, options) > 0)
+    {
+        return 1;
+    }
+    return 0;
+}
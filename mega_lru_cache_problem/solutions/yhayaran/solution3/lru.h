@@ -1,3 +1,6 @@
+#ifndef LRU_H
+#define LRU_H
+
 #include <string>
 #include <functional>
 #include <chrono>
@@ -12,7 +15,13 @@
 #include <sstream>
 #include <random>
 #include <chrono>
+#include <array>
+#include <limits>
+#include <type_traits>
 #include <assert.h>
+#include "lru_policy.h"
+#include "lru_tuning.h"
+#include "lru_ghost.h"
 
 class LRUCleanable
 {
@@ -41,6 +50,9 @@ private:
                     >
                 >::iterator mElementInListItr;  // Iterator: shared pointer of type 'LRUCacheElement<T,PK>'
     bool mMarkSizeWiseCleanup = false;
+    size_t mPriority = 0;                       // Priority class, 0 is evicted first
+    uint32_t mNameSpace = 0;                    // Namespace (tenant) owning the element
+    typename std::list<std::shared_ptr<LRUCacheElement<T,PK> > >::iterator mElementInNameSpaceListItr; // Iterator in the namespace list
 
 public:
     LRUCacheElement(std::shared_ptr<T> element, PK primaryKey)
@@ -77,7 +89,7 @@ public:
         return mWeakPointerElement;
     }
 
-    PK primaryKey() const
+    const PK &primaryKey() const
     {
         return mPrimaryKey;
     }
@@ -96,6 +108,160 @@ public:
     {
         return mMarkSizeWiseCleanup;
     }
+
+    size_t priority() const
+    {
+        return mPriority;
+    }
+
+    void setPriority(const size_t &priority)
+    {
+        mPriority = priority;
+    }
+
+    uint32_t nameSpace() const
+    {
+        return mNameSpace;
+    }
+
+    void setNameSpace(const uint32_t &nameSpace)
+    {
+        mNameSpace = nameSpace;
+    }
+
+    void setElementInNameSpaceListItr(const typename std::list<std::shared_ptr<LRUCacheElement<T, PK> > >::iterator &elementInNameSpaceListItr)
+    {
+        mElementInNameSpaceListItr = elementInNameSpaceListItr;
+    }
+
+    typename std::list<std::shared_ptr<LRUCacheElement<T,PK> > >::iterator elementInNameSpaceListItr() const
+    {
+        return mElementInNameSpaceListItr;
+    }
+};
+
+/**
+ * @brief cache_size trait to give the cache the size (bytes) of an element type that can't have a
+ * cacheSize() member. Specialize it with a static get, e.g.
+ * template <> struct cache_size<Blob> { static int64_t get(Blob &blob) { return blob.bytes(); } };
+ */
+template <typename T>
+struct cache_size
+{
+};
+
+template <typename T, typename = void>
+struct LRUHasCacheSizeTrait : std::false_type {};
+
+template <typename T>
+struct LRUHasCacheSizeTrait<T, std::void_t<decltype(cache_size<T>::get(std::declval<T&>()))>> : std::true_type {};
+
+template <typename T, typename = void>
+struct LRUHasCacheSizeMember : std::false_type {};
+
+template <typename T>
+struct LRUHasCacheSizeMember<T, std::void_t<decltype(std::declval<T&>().cacheSize())>> : std::true_type {};
+
+template <typename T>
+struct LRUHasCacheSize : std::integral_constant<bool, LRUHasCacheSizeTrait<T>::value || LRUHasCacheSizeMember<T>::value> {};
+
+/**
+ * @brief lruCacheSizeOf size of element as the cache sees it, cache_size<T> wins over a cacheSize() member
+ */
+template <typename T>
+int64_t lruCacheSizeOf(T &element)
+{
+    static_assert(LRUHasCacheSize<T>::value, "T must have a cacheSize() member or a cache_size<T> specialization");
+    if constexpr (LRUHasCacheSizeTrait<T>::value)
+        return static_cast<int64_t>(cache_size<T>::get(element));
+    else if constexpr (LRUHasCacheSizeMember<T>::value)
+        return static_cast<int64_t>(element.cacheSize());
+    else
+        return 0;
+}
+
+/**
+ * @brief LRUAutoSize tag for updateElement: the cache asks the element its size (see lruCacheSizeOf)
+ */
+struct LRUAutoSize {};
+
+/**
+ * @brief LRUSizeObserver handle an element can hold to report its own size changes to the cache
+ * it lives in, so accounting stays right when it grows in place. Get one with sizeObserver(key).
+ * Reporting does not change the recency of the element, and does nothing once the cache is gone.
+ */
+class LRUSizeObserver
+{
+public:
+    virtual ~LRUSizeObserver(){}
+
+    virtual void sizeChanged(int64_t size) = 0;
+};
+
+/**
+ * @brief LRUSizeObserverLink shared between a cache and its observers, cut by the cache destructor
+ */
+template <typename Cache, typename PK>
+class LRUSizeObserverLink
+{
+private:
+    std::recursive_mutex mMutex; // recursive: cleanup() may run element code that reports again
+    Cache *mCache;
+
+public:
+    explicit LRUSizeObserverLink(Cache *cache) : mCache(cache)
+    { }
+
+    void detach()
+    {
+        std::lock_guard<std::recursive_mutex> g(mMutex);
+        mCache = nullptr;
+    }
+
+    void resize(const PK &key, int64_t size)
+    {
+        std::lock_guard<std::recursive_mutex> g(mMutex);
+        if (mCache)
+        {
+            mCache->resize(key, size);
+        }
+    }
+};
+
+template <typename Cache, typename PK>
+class LRUCacheSizeObserver : public LRUSizeObserver
+{
+private:
+    std::weak_ptr<LRUSizeObserverLink<Cache, PK>> mLink;
+    PK mPrimaryKey;
+
+public:
+    LRUCacheSizeObserver(const std::shared_ptr<LRUSizeObserverLink<Cache, PK>> &link, const PK &primaryKey)
+        : mLink(link), mPrimaryKey(primaryKey)
+    { }
+
+    void sizeChanged(int64_t size) override
+    {
+        auto link = mLink.lock();
+        if (link)
+        {
+            link->resize(mPrimaryKey, size);
+        }
+    }
+};
+
+/**
+ * @brief LRUNamespaceStats counters kept for every namespace of a LRUCache
+ */
+struct LRUNamespaceStats
+{
+    int64_t size = 0;           // bytes currently held
+    int64_t elements = 0;       // elements currently held
+    int64_t inserts = 0;        // new keys added
+    int64_t updates = 0;        // existing keys updated
+    int64_t evictions = 0;      // elements dropped by cleanup
+    int64_t evictedBytes = 0;   // bytes dropped by cleanup
+    int64_t quotaEvictions = 0; // evictions caused by the namespace own quota
 };
 
 
@@ -109,17 +275,70 @@ public:
  * Also, when adding a new element, if certain hard limit is reached
  * cleanup will be also carried out.
  * Weak pointers failed to be locked will simply be removed from the cache upon cleanup
+ *
+ * Elements belong to one of NPriorityClasses priority classes, each with its own recency list.
+ * Cleanup drains class 0 first and only moves to a higher class once every lower class is empty
+ * or down to its reservation, so critical entries go after all best-effort ones.
+ *
+ * Elements also belong to a namespace (tenant, 0 by default) that can carry soft/hard quotas.
+ * Cleanup first trims namespaces above their soft quota, then falls back to the priority order.
+ * A borrowing namespace may keep more than its soft quota while the cache is under its soft limit.
+ *
+ * Sizes are either passed by the caller or, with LRUAutoSize, asked to the element through a
+ * cacheSize() member or a cache_size<T> specialization. With lazy sizes on, cleanup asks again
+ * right before evicting, so elements that changed size since insertion are accounted exactly.
+ *
+ * The policy (LRUPolicy) is LRU or size-then-LRU: within a priority class, elements not updated for a
+ * threshold go first, biggest first. With enableAdaptivePolicy, shadow caches of candidate policies run on
+ * a sample of the keys and the cache switches to the one with the best byte hit ratio (LRUPolicySelector).
+ *
+ * With enableMissRatioCurve, the cache estimates online the byte hit ratio it would have at any size
+ * (LRUMissRatioCurve), to pick maxSizeSoft from measures rather than guesses. With enableLimitTuning
+ * it picks them itself: the limits move, damped and within bounds, towards what the curve asks for (LRULimitTuner).
+ *
+ * With enableEvictionHistory, the last victims are remembered (LRUGhostHistory): keys updated again soon after
+ * cleanup dropped them are counted as premature evictions, by reason and size class.
  */
-template <typename T, typename PK/*primary_key*/>
+template <typename T, typename PK/*primary_key*/, size_t NPriorityClasses = 4>
 class LRUCache {
     static_assert(std::is_base_of<LRUCleanable, T>::value, "T must derive from LRUCleanable");
+    static_assert(NPriorityClasses > 0, "LRUCache needs at least one priority class");
+public:
+    typedef uint32_t NamespaceId;
+
 private:
-    std::list<std::shared_ptr<LRUCacheElement<T,PK>>> mListOfElements; //to keep order
-    std::map<PK,std::shared_ptr<LRUCacheElement<T,PK>>> mMapOfElements; //To ease the search
+    typedef std::shared_ptr<LRUCacheElement<T,PK>> SPTR_CACHE_ELEMENT;
+    typedef std::array<std::list<SPTR_CACHE_ELEMENT>, NPriorityClasses> PriorityLists;
+
+    // a tenant of the cache, its own recency lists let cleanup trim it alone
+    struct Namespace
+    {
+        int64_t quotaSoft = 0; //cleanup trims the namespace to this, 0 means no quota
+        int64_t quotaHard = 0; //going above this forces a cleanup, 0 means no quota
+        bool borrow = false; //may stay above quotaSoft while the cache is under its soft limit
+        LRUNamespaceStats stats;
+        PriorityLists lists;
+    };
+
+    PriorityLists mListOfElements; //to keep order, one list per priority
+    std::map<PK,SPTR_CACHE_ELEMENT,std::less<>> mMapOfElements; //To ease the search, transparent: found by anything comparable with PK
+    std::map<NamespaceId, Namespace> mNamespaces;
+    std::set<NamespaceId> mNamespacesOverQuota; //namespaces above their soft quota, first to be cleaned
+    std::array<int64_t, NPriorityClasses> mPrioritySize = {}; //bytes held by each priority class
+    std::array<int64_t, NPriorityClasses> mPriorityReserved = {}; //cleanup won't take a class below this
     int64_t mTotalSize = 0;
     int64_t mMaxSizeSoft = 0; //scheduled cleaner will act on this
     int64_t mMaxSizeHard = 0; //cache won't be allowed to exceed this
+    bool mLazySize = false; //ask elements their size again before evicting them
+    LRUPolicy mPolicy; //how cleanup picks victims out of mListOfElements
+    std::array<std::set<std::pair<int64_t, LRUCacheElement<T,PK>*>, std::greater<std::pair<int64_t, LRUCacheElement<T,PK>*>>>, NPriorityClasses> mOldBySize; //size-then-LRU: elements past the threshold, biggest first
+    std::array<typename std::list<SPTR_CACHE_ELEMENT>::iterator, NPriorityClasses> mFirstYoung; //size-then-LRU: elements before it are in mOldBySize
+    std::unique_ptr<LRUPolicySelector> mPolicySelector; //adaptive policy, nullptr when off
+    std::unique_ptr<LRUMissRatioCurve> mMissRatioCurve; //online miss-ratio curve, nullptr when off
+    std::unique_ptr<LRULimitTuner> mLimitTuner; //moves the limits along the curve, nullptr when off
+    std::unique_ptr<LRUGhostHistory> mGhostHistory; //last victims, to spot premature evictions, nullptr when off
     std::mutex elementsMutex;
+    std::shared_ptr<LRUSizeObserverLink<LRUCache, PK>> mSizeObserverLink = std::make_shared<LRUSizeObserverLink<LRUCache, PK>>(this);
 
     //cleaning thread stuff
     std::unique_ptr<std::thread> mCleanerThread;
@@ -144,16 +363,212 @@ private:
             std::unique_lock<std::mutex> lk(mCleanMutex);
             if (mCleancv.wait_for(lk,std::chrono::milliseconds(mCleanScheduleMs)) == std::cv_status::timeout)
             {
+                tuneLimits();
                 cleanup();
             }
             if (mFinished) break;
         }
     }
 
+    void refreshQuotaState(NamespaceId id, const Namespace &ns)
+    {
+        if ((ns.quotaSoft && ns.stats.size > ns.quotaSoft) || (ns.quotaHard && ns.stats.size > ns.quotaHard))
+            mNamespacesOverQuota.insert(id);
+        else
+            mNamespacesOverQuota.erase(id);
+    }
+
+    // insert at the back of the priority and namespace lists, and account its size
+    void linkElement(const SPTR_CACHE_ELEMENT &cacheElement)
+    {
+        auto &list = mListOfElements[cacheElement->priority()];
+        list.push_back(cacheElement);
+        cacheElement->setElementInListItr(std::prev(list.end()));
+        if (mFirstYoung[cacheElement->priority()] == list.end())
+            mFirstYoung[cacheElement->priority()] = std::prev(list.end());
+
+        auto &ns = mNamespaces[cacheElement->nameSpace()];
+        auto &nsList = ns.lists[cacheElement->priority()];
+        nsList.push_back(cacheElement);
+        cacheElement->setElementInNameSpaceListItr(std::prev(nsList.end()));
+
+        mPrioritySize[cacheElement->priority()] += cacheElement->size();
+        mTotalSize += cacheElement->size();
+        ns.stats.size += cacheElement->size();
+        ns.stats.elements++;
+        refreshQuotaState(cacheElement->nameSpace(), ns);
+    }
+
+    void unlinkElement(const SPTR_CACHE_ELEMENT &cacheElement)
+    {
+        if (cacheElement->getMarkSizeWiseCleanup())
+        {
+            mOldBySize[cacheElement->priority()].erase(std::make_pair(cacheElement->size(), cacheElement.get()));
+            cacheElement->setMarkSizeWiseCleanup(false);
+        }
+        if (mFirstYoung[cacheElement->priority()] == cacheElement->elementInListItr())
+            ++mFirstYoung[cacheElement->priority()];
+        mListOfElements[cacheElement->priority()].erase(cacheElement->elementInListItr());
+
+        auto &ns = mNamespaces[cacheElement->nameSpace()];
+        ns.lists[cacheElement->priority()].erase(cacheElement->elementInNameSpaceListItr());
+
+        mPrioritySize[cacheElement->priority()] -= cacheElement->size();
+        mTotalSize -= cacheElement->size();
+        ns.stats.size -= cacheElement->size();
+        ns.stats.elements--;
+        refreshQuotaState(cacheElement->nameSpace(), ns);
+    }
+
+    // lruKeyHash of a key, only instantiated for hashable keys: the features using it can't be enabled for others
+    static uint64_t keyHash(const PK &key)
+    {
+        if constexpr (lruIsHashable<PK>::value)
+            return lruKeyHash(key);
+        else
+            return 0;
+    }
+
+    void evictElement(SPTR_CACHE_ELEMENT el, std::vector<std::shared_ptr<LRUCleanable>> &toClean, LRUEvictionReason reason)
+    {
+        if (mGhostHistory)
+            mGhostHistory->evicted(keyHash(el->primaryKey()), el->size(), reason, std::time(nullptr));
+        unlinkElement(el);
+        mMapOfElements.erase(el->primaryKey());
+
+        auto &stats = mNamespaces[el->nameSpace()].stats;
+        stats.evictions++;
+        stats.evictedBytes += el->size();
+
+        auto weakPointerEl = el->weakPointerElement();
+        auto shrPointerEl = weakPointerEl.lock();
+        if (shrPointerEl)
+        {
+            toClean.push_back(shrPointerEl);
+        }
+    }
+
+    // account a size change of a linked element, returns true if a hard limit or quota is surpassed
+    bool applySize(const SPTR_CACHE_ELEMENT &cacheElement, int64_t size)
+    {
+        auto &ns = mNamespaces[cacheElement->nameSpace()];
+        int64_t delta = size - cacheElement->size();
+        if (cacheElement->getMarkSizeWiseCleanup())
+        {
+            // the size is part of the key of the size order
+            auto &oldBySize = mOldBySize[cacheElement->priority()];
+            oldBySize.erase(std::make_pair(cacheElement->size(), cacheElement.get()));
+            oldBySize.insert(std::make_pair(size, cacheElement.get()));
+        }
+        cacheElement->setSize(size);
+
+        mPrioritySize[cacheElement->priority()] += delta;
+        mTotalSize += delta;
+        ns.stats.size += delta;
+        refreshQuotaState(cacheElement->nameSpace(), ns);
+
+        return mTotalSize > mMaxSizeHard || (ns.quotaHard && ns.stats.size > ns.quotaHard);
+    }
+
+    // lazy sizes: ask the element its current size, returns true if it changed
+    bool refreshSize(const SPTR_CACHE_ELEMENT &cacheElement)
+    {
+        if constexpr (LRUHasCacheSize<T>::value)
+        {
+            auto shrPointerEl = cacheElement->weakPointerElement().lock();
+            if (mLazySize && shrPointerEl)
+            {
+                int64_t size = lruCacheSizeOf(*shrPointerEl);
+                if (size != cacheElement->size())
+                {
+                    applySize(cacheElement, size);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // size-then-LRU: moves the elements not updated for the threshold to the size order
+    void markOldElements()
+    {
+        if (mPolicy.kind != LRUPolicy::SizeThenLRU)
+            return;
+        int64_t now = std::time(nullptr);
+        for (size_t priority = 0; priority < NPriorityClasses; ++priority)
+        {
+            auto &itr = mFirstYoung[priority];
+            for (; itr != mListOfElements[priority].end() && now - (*itr)->getAccessTime() >= mPolicy.thresholdSec; ++itr)
+            {
+                (*itr)->setMarkSizeWiseCleanup(true);
+                mOldBySize[priority].insert(std::make_pair((*itr)->size(), itr->get()));
+            }
+        }
+    }
+
+    void applyPolicy(const LRUPolicy &policy)
+    {
+        mPolicy = policy;
+        // marks are redone from the front of the lists with the new threshold, or not at all for LRU
+        for (size_t priority = 0; priority < NPriorityClasses; ++priority)
+        {
+            for (auto &old : mOldBySize[priority])
+                old.second->setMarkSizeWiseCleanup(false);
+            mOldBySize[priority].clear();
+            mFirstYoung[priority] = mListOfElements[priority].begin();
+        }
+    }
+
+    // biggest element past the threshold of a priority class (size-then-LRU), nullptr if none
+    SPTR_CACHE_ELEMENT oldestBySize(size_t priority, const PK *keyToSaveFromPurge) const
+    {
+        for (auto &old : mOldBySize[priority])
+        {
+            if (!keyToSaveFromPurge || !(*keyToSaveFromPurge == old.second->primaryKey()))
+                return *old.second->elementInListItr();
+        }
+        return nullptr;
+    }
+
+    // LRU element of the lowest priority class that may go without breaking its reservation, nullptr if none.
+    // bySize: the biggest element past the size-then-LRU threshold comes first, if there is one (then pickedBySize is set)
+    SPTR_CACHE_ELEMENT victim(const PriorityLists &lists, const PK *keyToSaveFromPurge, bool bySize = false, bool *pickedBySize = nullptr) const
+    {
+        for (size_t priority = 0; priority < NPriorityClasses; ++priority)
+        {
+            if (bySize)
+            {
+                auto el = oldestBySize(priority, keyToSaveFromPurge);
+                if (el && mPrioritySize[priority] - el->size() >= mPriorityReserved[priority])
+                {
+                    if (pickedBySize)
+                        *pickedBySize = true;
+                    return el;
+                }
+            }
+            auto itr = lists[priority].begin();
+            if (itr != lists[priority].end() && keyToSaveFromPurge && *keyToSaveFromPurge == (*itr)->primaryKey())
+                ++itr; // a resized key may still sit at the front
+            if (itr == lists[priority].end())
+                continue;
+            if (mPrioritySize[priority] - (*itr)->size() >= mPriorityReserved[priority])
+                return *itr;
+        }
+        return nullptr;
+    }
+
+    // bytes a namespace may keep after cleanup
+    int64_t namespaceTarget(const Namespace &ns) const
+    {
+        if ((ns.borrow && mTotalSize <= mMaxSizeSoft) || !ns.quotaSoft) // a hard quota alone is the target
+            return ns.quotaHard ? ns.quotaHard : std::numeric_limits<int64_t>::max();
+        return ns.quotaSoft;
+    }
 
 public:
     ~LRUCache()
     {
+        mSizeObserverLink->detach();
         if (mCleanerThread)
         {
             end();
@@ -170,6 +585,8 @@ public:
     LRUCache(int64_t maxSizeSoft, int64_t maxSizeHard, int64_t cleanScheduleMs = 0)
         : mMaxSizeSoft(maxSizeSoft), mMaxSizeHard(maxSizeHard), mCleanScheduleMs(cleanScheduleMs)
     {
+        for (size_t priority = 0; priority < NPriorityClasses; ++priority)
+            mFirstYoung[priority] = mListOfElements[priority].end();
         if (cleanScheduleMs)
         {
             mCleanerThread.reset(new std::thread([this]()
@@ -180,80 +597,404 @@ public:
         }
     }
 
-    void updateElement(std::shared_ptr<T> element, const PK &key, int64_t size)
+    /**
+     * @brief setPriorityReservation protects a priority class working set
+     * @param priority Priority class (0 is evicted first)
+     * @param bytes Cleanup won't evict from this class below this many bytes
+     */
+    void setPriorityReservation(size_t priority, int64_t bytes)
+    {
+        assert(priority < NPriorityClasses);
+        std::lock_guard<std::mutex> g(elementsMutex);
+        mPriorityReserved[priority] = bytes;
+    }
+
+    /**
+     * @brief setPolicy how cleanup picks its victims (LRU by default), turns the adaptive policy off
+     */
+    void setPolicy(const LRUPolicy &policy)
+    {
+        std::lock_guard<std::mutex> g(elementsMutex);
+        mPolicySelector.reset();
+        applyPolicy(policy);
+    }
+
+    LRUPolicy policy()
     {
+        std::lock_guard<std::mutex> g(elementsMutex);
+        return mPolicy;
+    }
+
+    /**
+     * @brief enableAdaptivePolicy lets the cache pick its policy among candidates by the byte hit ratio of
+     * shadow caches (metadata only) run on a sample of the keys, see LRUPolicySelector
+     * @param candidates policies to compare, the first one is live at the start
+     */
+    void enableAdaptivePolicy(const std::vector<LRUPolicy> &candidates, const LRUPolicySelector::Options &options = LRUPolicySelector::Options())
+    {
+        static_assert(lruIsHashable<PK>::value, "enableAdaptivePolicy hashes the keys: std::hash<PK> is needed");
+        assert(!candidates.empty());
+        std::lock_guard<std::mutex> g(elementsMutex);
+        mPolicySelector.reset(new LRUPolicySelector(candidates, mMaxSizeSoft, options));
+        applyPolicy(mPolicySelector->livePolicy());
+    }
+
+    /**
+     * @brief policyStats what the adaptive policy saw, empty if it is off
+     */
+    LRUPolicyStats policyStats()
+    {
+        std::lock_guard<std::mutex> g(elementsMutex);
+        return mPolicySelector ? mPolicySelector->stats() : LRUPolicyStats();
+    }
+
+    /**
+     * @brief enableMissRatioCurve starts estimating the miss-ratio curve from the next updates, see LRUMissRatioCurve
+     * @param maxKeys most sampled keys tracked, fixes the memory used (~ 120 bytes per key)
+     * @param sampleRate sampling rate to start with, lowered when more than maxKeys keys are sampled
+     */
+    void enableMissRatioCurve(size_t maxKeys = 8192, double sampleRate = 0.1)
+    {
+        static_assert(lruIsHashable<PK>::value, "enableMissRatioCurve hashes the keys: std::hash<PK> is needed");
+        std::lock_guard<std::mutex> g(elementsMutex);
+        mMissRatioCurve.reset(new LRUMissRatioCurve(maxKeys, sampleRate));
+    }
+
+    void disableMissRatioCurve()
+    {
+        std::lock_guard<std::mutex> g(elementsMutex);
+        mLimitTuner.reset();
+        mMissRatioCurve.reset();
+    }
+
+    /**
+     * @brief hitRatioAt byte hit ratio the cache would have with a soft limit of bytes, 0 if the curve is off
+     */
+    double hitRatioAt(int64_t bytes)
+    {
+        std::lock_guard<std::mutex> g(elementsMutex);
+        return mMissRatioCurve ? mMissRatioCurve->hitRatio(bytes) : 0;
+    }
+
+    /**
+     * @brief missRatioCurve (bytes, byte hit ratio) at points sizes log-spaced from minBytes to maxBytes,
+     * empty if the curve is off
+     */
+    std::vector<std::pair<int64_t, double>> missRatioCurve(int64_t minBytes, int64_t maxBytes, size_t points)
+    {
+        std::lock_guard<std::mutex> g(elementsMutex);
+        return mMissRatioCurve ? mMissRatioCurve->curve(minBytes, maxBytes, points) : std::vector<std::pair<int64_t, double>>();
+    }
+
+    /**
+     * @brief decayMissRatioCurve scales what the curve saw so far by factor, e.g. 0.5 every hour to follow the workload
+     */
+    void decayMissRatioCurve(double factor)
+    {
+        std::lock_guard<std::mutex> g(elementsMutex);
+        if (mMissRatioCurve)
+            mMissRatioCurve->decay(factor);
+    }
+
+    /**
+     * @brief enableLimitTuning lets the cache move its soft and hard limits along its miss-ratio curve
+     * (enabled with its defaults if it is off), see LRULimitTuner. The cleaner thread steps it before
+     * each cleanup, without one call tuneLimits() periodically.
+     */
+    void enableLimitTuning(const LRULimitTuning &tuning)
+    {
+        static_assert(lruIsHashable<PK>::value, "enableLimitTuning hashes the keys: std::hash<PK> is needed");
+        std::lock_guard<std::mutex> g(elementsMutex);
+        if (!mMissRatioCurve)
+            mMissRatioCurve.reset(new LRUMissRatioCurve());
+        mLimitTuner.reset(new LRULimitTuner(tuning));
+    }
+
+    void disableLimitTuning()
+    {
+        std::lock_guard<std::mutex> g(elementsMutex);
+        mLimitTuner.reset();
+    }
+
+    /**
+     * @brief tuneLimits one step of the limit tuning, the next cleanup evicts down to a lowered soft limit
+     * @return true when the limits changed
+     */
+    bool tuneLimits()
+    {
+        std::lock_guard<std::mutex> g(elementsMutex);
+        if (!mLimitTuner || !mLimitTuner->step(*mMissRatioCurve, mMaxSizeSoft, mMaxSizeHard))
+            return false;
+        if (mPolicySelector)
+            mPolicySelector->setSoftLimit(mMaxSizeSoft);
+        return true;
+    }
+
+    int64_t maxSizeSoft()
+    {
+        std::lock_guard<std::mutex> g(elementsMutex);
+        return mMaxSizeSoft;
+    }
+
+    int64_t maxSizeHard()
+    {
+        std::lock_guard<std::mutex> g(elementsMutex);
+        return mMaxSizeHard;
+    }
+
+    int64_t totalSize()
+    {
+        std::lock_guard<std::mutex> g(elementsMutex);
+        return mTotalSize;
+    }
+
+    int64_t prioritySize(size_t priority)
+    {
+        assert(priority < NPriorityClasses);
+        std::lock_guard<std::mutex> g(elementsMutex);
+        return mPrioritySize[priority];
+    }
+
+    /**
+     * @brief setNamespaceQuota limits the bytes a namespace (tenant) may hold
+     * @param id Namespace
+     * @param quotaSoft Soft quota (bytes): cleaning will first trim the namespace to this, 0 for none
+     * @param quotaHard Hard quota (bytes): surpassing this will force a cleaning (down to it without a soft quota), 0 for none
+     * @param borrow if true, the namespace may use idle capacity above quotaSoft (up to quotaHard)
+     * while the whole cache is under its soft limit
+     */
+    void setNamespaceQuota(NamespaceId id, int64_t quotaSoft, int64_t quotaHard = 0, bool borrow = false)
+    {
+        std::lock_guard<std::mutex> g(elementsMutex);
+        auto &ns = mNamespaces[id];
+        ns.quotaSoft = quotaSoft;
+        ns.quotaHard = quotaHard;
+        ns.borrow = borrow;
+        refreshQuotaState(id, ns);
+    }
+
+    LRUNamespaceStats namespaceStats(NamespaceId id)
+    {
+        std::lock_guard<std::mutex> g(elementsMutex);
+        auto itr = mNamespaces.find(id);
+        return itr != mNamespaces.end() ? itr->second.stats : LRUNamespaceStats();
+    }
+
+    /**
+     * @brief setLazySize makes cleanup ask elements their size again right before evicting them
+     * The element cacheSize() (or cache_size<T>) is then called under the cache lock: it must not call the cache.
+     */
+    template <typename U = T>
+    void setLazySize(bool lazySize)
+    {
+        static_assert(LRUHasCacheSize<U>::value, "lazy sizes need a cacheSize() member or a cache_size<T> specialization");
+        std::lock_guard<std::mutex> g(elementsMutex);
+        mLazySize = lazySize;
+    }
+
+    /**
+     * @brief updateElement adds or refreshes an element, asking the element its size
+     */
+    void updateElement(std::shared_ptr<T> element, const PK &key, LRUAutoSize = LRUAutoSize(), size_t priority = 0, NamespaceId nameSpace = 0)
+    {
+        int64_t size = lruCacheSizeOf(*element);
+        updateElement(element, key, size, priority, nameSpace);
+    }
+
+    void updateElement(std::shared_ptr<T> element, const PK &key, int64_t size, size_t priority = 0, NamespaceId nameSpace = 0)
+    {
+        assert(priority < NPriorityClasses);
+        bool overLimit = false;
         {
             std::lock_guard<std::mutex> g(elementsMutex);
 
-            std::shared_ptr<LRUCacheElement<T,PK>> cacheElement;
+            SPTR_CACHE_ELEMENT cacheElement;
 
             auto itrMap = mMapOfElements.find(key);
-            if (itrMap == mMapOfElements.end())
+            bool inserted = itrMap == mMapOfElements.end();
+            if (inserted)
             {
                 cacheElement = std::make_shared<LRUCacheElement<T,PK>>(element, key);
-                mMapOfElements.insert(std::pair<PK,std::shared_ptr<LRUCacheElement<T,PK>>>(key, cacheElement));
+                mMapOfElements.insert(std::pair<PK,SPTR_CACHE_ELEMENT>(key, cacheElement));
+                mNamespaces[nameSpace].stats.inserts++;
             }
-            else //remove from list to reorder when inserting
+            else //remove from lists to reorder when inserting
             {
                 cacheElement = itrMap->second;
-                mListOfElements.erase(cacheElement->elementInListItr());
-                mTotalSize -= cacheElement->size();
+                unlinkElement(cacheElement);
+                mNamespaces[nameSpace].stats.updates++;
             }
 
             cacheElement->setSize(size);
-            mTotalSize += size;
+            cacheElement->setPriority(priority);
+            cacheElement->setNameSpace(nameSpace);
 
             cacheElement->updateAccessTime();
 
-            mListOfElements.push_back(cacheElement);// insert at the back, and save the itr in the element
-            cacheElement->setElementInListItr(std::prev(mListOfElements.end()));
+            linkElement(cacheElement);
+
+            if (mPolicySelector || mMissRatioCurve || (inserted && mGhostHistory))
+            {
+                uint64_t hash = keyHash(key);
+                if (inserted && mGhostHistory)
+                    mGhostHistory->inserted(hash, cacheElement->getAccessTime());
+                if (mMissRatioCurve)
+                    mMissRatioCurve->access(hash, size);
+                if (mPolicySelector && mPolicySelector->access(hash, size, cacheElement->getAccessTime()))
+                    applyPolicy(mPolicySelector->livePolicy());
+            }
+
+            auto &ns = mNamespaces[nameSpace];
+            overLimit = mTotalSize > mMaxSizeHard || (ns.quotaHard && ns.stats.size > ns.quotaHard);
+        }
+        if (overLimit)
+        {
+            cleanup(&key, true);
+        }
+    }
+
+
+    /**
+     * @brief resize updates the size of a cached element without changing its recency
+     * @param key Primary key of the element, or anything comparable with it (e.g. a stringTypeView)
+     * @param size New size (bytes), surpassing the hard limit will force a cleaning
+     * @return false if the key is not in the cache
+     */
+    template <typename K>
+    bool resize(const K &key, int64_t size)
+    {
+        bool overLimit = false;
+        SPTR_CACHE_ELEMENT el; //keeps the saved key alive through the cleanup
+        {
+            std::lock_guard<std::mutex> g(elementsMutex);
+
+            auto itrMap = mMapOfElements.find(key);
+            if (itrMap == mMapOfElements.end())
+            {
+                return false;
+            }
+
+            el = itrMap->second;
+            overLimit = applySize(el, size);
         }
-        if (mTotalSize > mMaxSizeHard)
+        if (overLimit)
         {
-            cleanup(&key);
+            cleanup(&el->primaryKey(), true);
         }
+        return true;
     }
 
+    /**
+     * @brief sizeObserver handle for the element cached under key to report its own size changes
+     */
+    std::shared_ptr<LRUSizeObserver> sizeObserver(const PK &key)
+    {
+        return std::make_shared<LRUCacheSizeObserver<LRUCache, PK>>(mSizeObserverLink, key);
+    }
 
-    void removeElement(const PK &key)
+    /**
+     * @brief contains true if something is cached under key, without touching its recency.
+     * Like removeElement and resize, key needs not be a PK: no temporary key is built for the lookup.
+     */
+    template <typename K>
+    bool contains(const K &key)
     {
         std::lock_guard<std::mutex> g(elementsMutex);
+        return mMapOfElements.find(key) != mMapOfElements.end();
+    }
 
-        std::shared_ptr<LRUCacheElement<T, PK>> cacheElement;
+    template <typename K>
+    void removeElement(const K &key)
+    {
+        std::lock_guard<std::mutex> g(elementsMutex);
 
         auto itrMap = mMapOfElements.find(key);
-        if (itrMap != mMapOfElements.end()) //remove from set to reorder when inserting
+        if (itrMap != mMapOfElements.end())
         {
-            cacheElement = itrMap->second;
-            mListOfElements.erase(cacheElement->elementInListItr());
-            mTotalSize -= cacheElement->size();
-
+            if (mPolicySelector)
+                mPolicySelector->remove(keyHash(itrMap->first));
+            if (mMissRatioCurve)
+                mMissRatioCurve->remove(keyHash(itrMap->first));
+            unlinkElement(itrMap->second);
             mMapOfElements.erase(itrMap);
         }
     }
 
     void cleanup(const PK *keyToSaveFromPurge = nullptr)
+    {
+        cleanup(keyToSaveFromPurge, false);
+    }
+
+    /**
+     * @brief enableEvictionHistory remembers the last capacity victims, see LRUGhostHistory
+     * @param windowSec a victim updated again within this many seconds counts as a premature eviction
+     */
+    void enableEvictionHistory(size_t capacity = 65536, int64_t windowSec = 60)
+    {
+        static_assert(lruIsHashable<PK>::value, "enableEvictionHistory hashes the keys: std::hash<PK> is needed");
+        std::lock_guard<std::mutex> g(elementsMutex);
+        mGhostHistory.reset(new LRUGhostHistory(capacity, windowSec));
+    }
+
+    void disableEvictionHistory()
+    {
+        std::lock_guard<std::mutex> g(elementsMutex);
+        mGhostHistory.reset();
+    }
+
+    /**
+     * @brief evictionHistoryStats evictions and premature evictions by reason and size class, empty if the history is off
+     */
+    LRUEvictionHistoryStats evictionHistoryStats()
+    {
+        std::lock_guard<std::mutex> g(elementsMutex);
+        return mGhostHistory ? mGhostHistory->stats() : LRUEvictionHistoryStats();
+    }
+
+private:
+    // forcedByHardLimit: an update or a size report went over the hard limit, victims are counted as such
+    void cleanup(const PK *keyToSaveFromPurge, bool forcedByHardLimit)
     {
         std::vector<std::shared_ptr<LRUCleanable>> toClean;
         {
             std::lock_guard<std::mutex> g(elementsMutex);
-            while (mListOfElements.size() &&  mTotalSize > mMaxSizeSoft)
+            SPTR_CACHE_ELEMENT refreshed; // a lazy size is asked once per victim
+
+            // namespaces over quota are trimmed first, each from its own lists
+            for (auto itr = mNamespacesOverQuota.begin(); itr != mNamespacesOverQuota.end(); )
             {
-                auto el = mListOfElements.front();
-                mListOfElements.pop_front();
-                mMapOfElements.erase(el->primaryKey());
-                if (!keyToSaveFromPurge || *keyToSaveFromPurge != el->primaryKey())
+                auto &ns = mNamespaces[*itr++]; // evicting may drop the id from the set
+                while (ns.stats.size > namespaceTarget(ns))
                 {
-                    auto weakPointerEl = el->weakPointerElement();
-                    auto shrPointerEl = weakPointerEl.lock();
-                    if (shrPointerEl)
+                    auto el = victim(ns.lists, keyToSaveFromPurge);
+                    if (!el)
+                        break;
+                    if (el != refreshed && refreshSize(el))
                     {
-                        toClean.push_back(shrPointerEl);
+                        refreshed = el;
+                        continue; // sizes changed, look again
                     }
 
-                    mTotalSize -= el->size();
+                    evictElement(el, toClean, LRUEvictQuota);
+                    ns.stats.quotaEvictions++;
                 }
             }
+
+            markOldElements();
+            while (mTotalSize > mMaxSizeSoft)
+            {
+                bool pickedBySize = false;
+                auto el = victim(mListOfElements, keyToSaveFromPurge, mPolicy.kind == LRUPolicy::SizeThenLRU, &pickedBySize);
+                if (!el)
+                    break; // everything left is reserved or the key being saved
+                if (el != refreshed && refreshSize(el))
+                {
+                    refreshed = el;
+                    continue; // sizes changed, look again
+                }
+
+                evictElement(el, toClean, forcedByHardLimit ? LRUEvictHardLimit : (pickedBySize ? LRUEvictSizeOrder : LRUEvictLRU));
+            }
         }
 
         for (auto &elementToClean : toClean)
@@ -264,3 +1005,4 @@ public:
 
 };
 
+#endif // LRU_H
@@ -0,0 +1,108 @@
+#ifndef LRU_COUNTING_RESOURCE_H
+#define LRU_COUNTING_RESOURCE_H
+
+#include "lru.h"
+#include <atomic>
+#include <memory_resource>
+
+/**
+ * @brief LRUCountingResource is a PMR memory resource that counts the bytes its users hold.
+ * Elements (or a group of elements) allocate their payload from their own resource,
+ * so the cache can account what is really on the heap instead of a size guessed by the caller.
+ *
+ * Two ways to feed the cache from it:
+ * 1) return bytesInUse() from the element cacheSize() and insert with LRUAutoSize,
+ *    lazy sizes (setLazySize) then read it again before evicting.
+ * 2) trackResource() below: every allocation/deallocation reports the new total to the cache,
+ *    once it moved by at least reportGranularity bytes since the last report.
+ *
+ * Allocations are forwarded to the upstream resource (new/delete by default).
+ */
+class LRUCountingResource : public std::pmr::memory_resource
+{
+private:
+    std::pmr::memory_resource *mUpstream;
+    int64_t mReportGranularity;
+    std::atomic<int64_t> mBytesInUse{0};
+    std::atomic<int64_t> mLastReported{0};
+    std::atomic<int64_t> mAllocations{0};
+    std::shared_ptr<LRUSizeObserver> mSizeObserver; // set before allocating, not synchronized
+
+    void report(int64_t bytesInUse)
+    {
+        if (!mSizeObserver)
+            return;
+        int64_t lastReported = mLastReported.load(std::memory_order_relaxed);
+        int64_t moved = bytesInUse > lastReported ? bytesInUse - lastReported : lastReported - bytesInUse;
+        if (moved >= mReportGranularity && moved > 0
+            && mLastReported.compare_exchange_strong(lastReported, bytesInUse, std::memory_order_relaxed))
+        {
+            mSizeObserver->sizeChanged(bytesInUse);
+        }
+    }
+
+protected:
+    void *do_allocate(size_t bytes, size_t alignment) override
+    {
+        void *p = mUpstream->allocate(bytes, alignment);
+        mAllocations.fetch_add(1, std::memory_order_relaxed);
+        report(mBytesInUse.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed) + static_cast<int64_t>(bytes));
+        return p;
+    }
+
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override
+    {
+        mUpstream->deallocate(p, bytes, alignment);
+        report(mBytesInUse.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed) - static_cast<int64_t>(bytes));
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+
+public:
+    /**
+     * @brief LRUCountingResource
+     * @param upstream Resource doing the real allocations
+     * @param reportGranularity Bytes the total must move before the size observer is told again
+     */
+    explicit LRUCountingResource(std::pmr::memory_resource *upstream = std::pmr::new_delete_resource(), int64_t reportGranularity = 0)
+        : mUpstream(upstream), mReportGranularity(reportGranularity)
+    { }
+
+    LRUCountingResource(const LRUCountingResource &) = delete;
+    LRUCountingResource &operator=(const LRUCountingResource &) = delete;
+
+    int64_t bytesInUse() const
+    {
+        return mBytesInUse.load(std::memory_order_relaxed);
+    }
+
+    int64_t allocations() const
+    {
+        return mAllocations.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief setSizeObserver observer told about the bytes in use, see LRUCache::sizeObserver()
+     */
+    void setSizeObserver(const std::shared_ptr<LRUSizeObserver> &sizeObserver)
+    {
+        mSizeObserver = sizeObserver;
+        mLastReported.store(bytesInUse(), std::memory_order_relaxed);
+    }
+};
+
+/**
+ * @brief trackResource makes cache account the element (or group) cached under key with the bytes
+ * in use of resource, now and after every allocation or deallocation from it.
+ */
+template <typename Cache, typename PK>
+void trackResource(Cache &cache, const PK &key, LRUCountingResource &resource)
+{
+    resource.setSizeObserver(cache.sizeObserver(key));
+    cache.resize(key, resource.bytesInUse());
+}
+
+#endif // LRU_COUNTING_RESOURCE_H
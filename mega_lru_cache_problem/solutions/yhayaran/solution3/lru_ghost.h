@@ -0,0 +1,202 @@
+#ifndef LRU_GHOST_H
+#define LRU_GHOST_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief LRUEvictionReason why cleanup dropped an element
+ * Quota: its namespace was over its soft quota.
+ * SizeOrder: the biggest element past the size-then-LRU threshold (LRUPolicy::SizeThenLRU).
+ * LRU: the least recently updated, the cache was over its soft limit.
+ * HardLimit: either of the two, in a cleanup forced by an update or a size report over the hard limit.
+ */
+enum LRUEvictionReason
+{
+    LRUEvictQuota,
+    LRUEvictSizeOrder,
+    LRUEvictLRU,
+    LRUEvictHardLimit,
+    LRUEvictionReasons
+};
+
+inline std::string lruEvictionReasonName(LRUEvictionReason reason)
+{
+    static const char *names[LRUEvictionReasons] = {"quota", "size-order", "lru", "hard-limit"};
+    return names[reason];
+}
+
+/**
+ * @brief LRUEvictionHistoryStats evictions and premature evictions (keys updated again within the window after
+ * being evicted) by reason and by size class: class i holds sizes in [4^i, 4^(i+1)), the last one all above
+ */
+struct LRUEvictionHistoryStats
+{
+    static constexpr size_t kSizeClasses = 16;
+    typedef std::array<std::array<int64_t, kSizeClasses>, LRUEvictionReasons> Counts;
+
+    Counts evictions = {};
+    Counts premature = {};
+    int64_t lateReturns = 0;    // evicted keys updated again after the window: the eviction paid off
+    int64_t ghosts = 0;         // victims remembered now
+    int64_t windowSec = 0;
+
+    static size_t sizeClass(int64_t size)
+    {
+        if (size < 4)
+            return 0;
+        return std::min<size_t>(kSizeClasses - 1, (63 - __builtin_clzll(static_cast<uint64_t>(size))) / 2);
+    }
+
+    // smallest size of a class
+    static int64_t sizeClassLow(size_t sizeClass)
+    {
+        return sizeClass == 0 ? 0 : int64_t(1) << (2 * sizeClass);
+    }
+
+    static int64_t total(const std::array<int64_t, kSizeClasses> &bySize)
+    {
+        int64_t sum = 0;
+        for (int64_t count : bySize)
+            sum += count;
+        return sum;
+    }
+
+    // share of the evictions of a reason that came back within the window
+    double prematureRatio(LRUEvictionReason reason) const
+    {
+        int64_t evicted = total(evictions[reason]);
+        return evicted ? static_cast<double>(total(premature[reason])) / evicted : 0;
+    }
+};
+
+/**
+ * @brief LRUGhostHistory bounded FIFO of the last victims of a cache: key hash (lruKeyHash), eviction time,
+ * reason and size class, 24 bytes in a ring plus 8 in an open addressing index, no allocation after construction.
+ * A key updated again while its ghost is still there was evicted too early if it came back within windowSec:
+ * limits, quotas or the size-then-LRU threshold are too tight for it. The oldest ghosts are overwritten, so
+ * capacity must hold the victims of at least windowSec for the counts to be complete.
+ */
+class LRUGhostHistory
+{
+private:
+    struct Ghost
+    {
+        uint64_t hash;
+        int64_t evictedAt;
+        uint8_t reason;
+        uint8_t sizeClass;
+        bool live; // still in the index (not returned yet)
+    };
+
+    static constexpr uint32_t kEmpty = ~uint32_t(0);
+
+    std::vector<Ghost> mRing;
+    size_t mNext = 0;           // slot the next victim takes
+    std::vector<uint32_t> mIndex; // ring slots by hash, linear probing, 2x the ring so probes stay short
+    LRUEvictionHistoryStats mStats;
+
+    size_t home(uint64_t hash) const
+    {
+        return (hash >> 32 ^ hash) & (mIndex.size() - 1);
+    }
+
+    // index position of the ghost of hash, or of the empty slot ending its probe sequence
+    size_t probe(uint64_t hash) const
+    {
+        size_t mask = mIndex.size() - 1;
+        size_t i = home(hash);
+        while (mIndex[i] != kEmpty && mRing[mIndex[i]].hash != hash)
+            i = (i + 1) & mask;
+        return i;
+    }
+
+    // backward shift deletion: entries after the hole move back if their probe sequence crosses it
+    void erase(size_t hole)
+    {
+        size_t mask = mIndex.size() - 1;
+        mRing[mIndex[hole]].live = false;
+        mIndex[hole] = kEmpty;
+        for (size_t i = (hole + 1) & mask; mIndex[i] != kEmpty; i = (i + 1) & mask)
+        {
+            size_t want = home(mRing[mIndex[i]].hash);
+            if (((i - want) & mask) >= ((i - hole) & mask))
+            {
+                mIndex[hole] = mIndex[i];
+                mIndex[i] = kEmpty;
+                hole = i;
+            }
+        }
+        mStats.ghosts--;
+    }
+
+public:
+    /**
+     * @param capacity victims remembered
+     * @param windowSec a victim updated again within this many seconds was evicted prematurely
+     */
+    LRUGhostHistory(size_t capacity, int64_t windowSec)
+        : mRing(std::max<size_t>(capacity, 1), Ghost{0, 0, 0, 0, false})
+    {
+        size_t indexSize = 1;
+        while (indexSize < 2 * mRing.size())
+            indexSize *= 2;
+        mIndex.assign(indexSize, kEmpty);
+        mStats.windowSec = windowSec;
+    }
+
+    /**
+     * @brief evicted remembers a victim, forgetting the oldest one if the history is full
+     */
+    void evicted(uint64_t hash, int64_t size, LRUEvictionReason reason, int64_t now)
+    {
+        size_t sizeClass = LRUEvictionHistoryStats::sizeClass(size);
+        mStats.evictions[reason][sizeClass]++;
+
+        Ghost &oldest = mRing[mNext];
+        if (oldest.live)
+            erase(probe(oldest.hash));
+
+        size_t i = probe(hash);
+        if (mIndex[i] != kEmpty) // evicted again without coming back through inserted (lost history)
+        {
+            erase(i);
+            i = probe(hash);
+        }
+
+        mRing[mNext] = Ghost{hash, now, static_cast<uint8_t>(reason), static_cast<uint8_t>(sizeClass), true};
+        mIndex[i] = static_cast<uint32_t>(mNext);
+        mStats.ghosts++;
+        mNext = (mNext + 1) % mRing.size();
+    }
+
+    /**
+     * @brief inserted a key new to the cache: if it is a ghost, its eviction is judged and the ghost dropped
+     * @return true when it was evicted prematurely
+     */
+    bool inserted(uint64_t hash, int64_t now)
+    {
+        size_t i = probe(hash);
+        if (mIndex[i] == kEmpty)
+            return false;
+
+        const Ghost &ghost = mRing[mIndex[i]];
+        bool premature = now - ghost.evictedAt <= mStats.windowSec;
+        if (premature)
+            mStats.premature[ghost.reason][ghost.sizeClass]++;
+        else
+            mStats.lateReturns++;
+        erase(i);
+        return premature;
+    }
+
+    const LRUEvictionHistoryStats &stats() const
+    {
+        return mStats;
+    }
+};
+
+#endif // LRU_GHOST_H
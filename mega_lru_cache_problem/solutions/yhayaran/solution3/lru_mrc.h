@@ -0,0 +1,302 @@
+#ifndef LRU_MRC_H
+#define LRU_MRC_H
+
+#include "lru_sampling.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief LRUMissRatioCurve online byte miss-ratio curve of an LRU cache, for any size at once.
+ * Reuse distances are measured on a spatially hashed sample of the keys (SHARDS, fixed size version):
+ * the distance of an access is the bytes of the distinct sampled keys updated since the last update of
+ * the same key, divided by the sampling rate. An LRU cache of X bytes hits the access when that distance
+ * plus the key's size fits in X, so the histogram of the distances, weighted by the bytes accessed,
+ * gives the byte hit ratio at every X.
+ *
+ * Memory is fixed: at most maxKeys keys are tracked. When one more comes the rate is lowered, dropping
+ * the keys of the highest hash positions, so the sample stays spatially uniform. Each sampled update
+ * counts for 1/rate updates, so those seen before the rate went down do not weigh more than the others
+ * (SHARDS paper: the error stays within a few points with a few thousand keys).
+ * Recency is a Fenwick tree of the key sizes indexed by a logical clock of the updates, compacted
+ * when the clock reaches 2 * maxKeys: O(log maxKeys) per sampled update, amortized.
+ * Distances go in log-spaced buckets, 8 per power of two (12% wide at most).
+ */
+class LRUMissRatioCurve
+{
+public:
+    static constexpr size_t kSubBuckets = 8;
+    static constexpr size_t kBuckets = 1 + 64 * kSubBuckets; // [0, 1) then 8 per power of two
+
+private:
+    struct Key
+    {
+        uint64_t stamp;
+        int64_t size;
+    };
+
+    LRUKeySampler mSampler;
+    size_t mMaxKeys;
+    std::unordered_map<uint64_t, Key> mKeys;
+    std::set<std::pair<uint64_t, uint64_t>> mByPosition; // (sampling position, hash): the last ones are dropped first
+    std::vector<int64_t> mFenwick; // bytes of the key last updated at each stamp, 1-based
+    uint64_t mClock = 0;
+    int64_t mTrackedBytes = 0;
+    std::array<double, kBuckets> mHitBytes = {}; // accessed bytes by bucket of reuse distance (+ own size)
+    std::array<double, kBuckets> mHitCount = {};
+    double mColdBytes = 0; // first updates (as seen by the sample): misses at any size
+    double mColdCount = 0;
+    double mSeenBytes = 0; // all updates, sampled or not
+    double mSeenCount = 0;
+    uint64_t mUpdates = 0; // all updates, not decayed
+
+    void add(uint64_t stamp, int64_t size)
+    {
+        for (; stamp < mFenwick.size(); stamp += stamp & (~stamp + 1))
+            mFenwick[stamp] += size;
+    }
+
+    // bytes last updated at stamps [1, stamp]
+    int64_t prefix(uint64_t stamp) const
+    {
+        int64_t sum = 0;
+        for (; stamp > 0; stamp -= stamp & (~stamp + 1))
+            sum += mFenwick[stamp];
+        return sum;
+    }
+
+    // renumbers the tracked keys 1..n in stamp order, the clock starts again after them
+    void compact()
+    {
+        std::vector<std::pair<uint64_t, uint64_t>> byStamp;
+        byStamp.reserve(mKeys.size());
+        for (auto &key : mKeys)
+            byStamp.push_back(std::make_pair(key.second.stamp, key.first));
+        std::sort(byStamp.begin(), byStamp.end());
+
+        std::fill(mFenwick.begin(), mFenwick.end(), 0);
+        mClock = 0;
+        for (auto &entry : byStamp)
+        {
+            Key &key = mKeys[entry.second];
+            key.stamp = ++mClock;
+            add(key.stamp, key.size);
+        }
+    }
+
+    void untrack(uint64_t keyHash)
+    {
+        auto itr = mKeys.find(keyHash);
+        if (itr == mKeys.end())
+            return;
+        add(itr->second.stamp, -itr->second.size);
+        mTrackedBytes -= itr->second.size;
+        mByPosition.erase(std::make_pair(LRUKeySampler::position(keyHash), keyHash));
+        mKeys.erase(itr);
+    }
+
+    // one key too many: the rate goes down to drop the keys of the highest position
+    void shrinkSample()
+    {
+        while (mKeys.size() > mMaxKeys)
+        {
+            uint64_t position = mByPosition.rbegin()->first;
+            mSampler.setThreshold(position);
+            while (!mByPosition.empty() && mByPosition.rbegin()->first >= position)
+                untrack(mByPosition.rbegin()->second);
+        }
+    }
+
+    static size_t bucket(double distance)
+    {
+        if (distance < 1)
+            return 0;
+        uint64_t d = distance >= 1.8e19 ? ~uint64_t(0) : static_cast<uint64_t>(distance);
+        int e = 63 - __builtin_clzll(d);
+        uint64_t sub = e >= 3 ? (d >> (e - 3)) & 7 : (d << (3 - e)) & 7;
+        return 1 + e * kSubBuckets + sub;
+    }
+
+    // smallest distance of a bucket
+    static double bucketLow(size_t index)
+    {
+        if (index == 0)
+            return 0;
+        size_t e = (index - 1) / kSubBuckets;
+        size_t sub = (index - 1) % kSubBuckets;
+        return static_cast<double>(kSubBuckets + sub) / kSubBuckets * static_cast<double>(uint64_t(1) << e);
+    }
+
+    static double bucketHigh(size_t index)
+    {
+        return index + 1 < kBuckets ? bucketLow(index + 1) : 2 * bucketLow(index);
+    }
+
+    // accessed bytes (weighted) that a cache of cacheBytes hits, buckets it cuts are taken pro rata
+    static double hitBytes(const std::array<double, kBuckets> &histogram, double cacheBytes)
+    {
+        double hit = 0;
+        for (size_t i = 0; i < kBuckets && bucketLow(i) < cacheBytes; ++i)
+        {
+            double high = bucketHigh(i);
+            hit += high <= cacheBytes ? histogram[i] : histogram[i] * (cacheBytes - bucketLow(i)) / (high - bucketLow(i));
+        }
+        return hit;
+    }
+
+    // share of seen that a cache of cacheBytes hits. The sample holds too many or too few updates when a
+    // very hot key is in it or not: the difference with what was really seen goes to the smallest distances
+    // (SHARDS-adj), as the hottest keys are the ones that move the count and they have short distances.
+    static double ratio(const std::array<double, kBuckets> &histogram, double cold, double seen, double cacheBytes)
+    {
+        double sampled = cold;
+        for (double weight : histogram)
+            sampled += weight;
+        if (seen <= 0 || sampled <= 0)
+            return 0;
+        double hit = hitBytes(histogram, cacheBytes) + (cacheBytes > 0 ? seen - sampled : 0);
+        return std::min(1.0, std::max(0.0, hit / seen));
+    }
+
+public:
+    /**
+     * @param maxKeys most keys tracked at once (memory: ~ 120 bytes each)
+     * @param rate sampling rate to start with, lowered when more than maxKeys keys show up
+     */
+    explicit LRUMissRatioCurve(size_t maxKeys = 8192, double rate = 0.1)
+        : mSampler(rate), mMaxKeys(maxKeys), mFenwick(2 * maxKeys + 1, 0)
+    { }
+
+    /**
+     * @brief access an update of the key of hash keyHash (lruKeyHash) and size bytes
+     */
+    void access(uint64_t keyHash, int64_t size)
+    {
+        mSeenBytes += size;
+        mSeenCount++;
+        mUpdates++;
+        if (!mSampler.sampled(keyHash))
+            return;
+
+        // an update seen at rate R stands for 1/R updates: the rate went down since the first ones
+        double weight = 1 / mSampler.rate();
+        auto itr = mKeys.find(keyHash);
+        if (itr == mKeys.end())
+        {
+            mColdBytes += weight * size;
+            mColdCount += weight;
+            mByPosition.insert(std::make_pair(LRUKeySampler::position(keyHash), keyHash));
+            itr = mKeys.insert(std::make_pair(keyHash, Key{0, 0})).first;
+        }
+        else
+        {
+            // bytes of the keys updated since, then its own: the LRU size that still holds it
+            double distance = static_cast<double>(mTrackedBytes - prefix(itr->second.stamp)) * weight + itr->second.size;
+            size_t index = bucket(distance);
+            mHitBytes[index] += weight * size;
+            mHitCount[index] += weight;
+            add(itr->second.stamp, -itr->second.size);
+            mTrackedBytes -= itr->second.size;
+            itr->second.size = 0; // compact below must not count it again
+        }
+
+        if (mClock + 1 >= mFenwick.size())
+            compact();
+        itr->second.stamp = ++mClock;
+        itr->second.size = size;
+        add(itr->second.stamp, size);
+        mTrackedBytes += size;
+
+        shrinkSample();
+    }
+
+    /**
+     * @brief remove a key removed on purpose: its next update is a miss whatever the size
+     */
+    void remove(uint64_t keyHash)
+    {
+        untrack(keyHash);
+    }
+
+    /**
+     * @brief hitRatio byte hit ratio of an LRU cache of cacheBytes over the updates seen
+     */
+    double hitRatio(int64_t cacheBytes) const
+    {
+        return ratio(mHitBytes, mColdBytes, mSeenBytes, static_cast<double>(cacheBytes));
+    }
+
+    double missRatio(int64_t cacheBytes) const
+    {
+        return 1 - hitRatio(cacheBytes);
+    }
+
+    /**
+     * @brief objectHitRatio ratio of updates (not bytes) hit by an LRU cache of cacheBytes
+     */
+    double objectHitRatio(int64_t cacheBytes) const
+    {
+        return ratio(mHitCount, mColdCount, mSeenCount, static_cast<double>(cacheBytes));
+    }
+
+    /**
+     * @brief curve (cache bytes, byte hit ratio) at points sizes log-spaced from minBytes to maxBytes
+     */
+    std::vector<std::pair<int64_t, double>> curve(int64_t minBytes, int64_t maxBytes, size_t points) const
+    {
+        std::vector<std::pair<int64_t, double>> result;
+        double size = static_cast<double>(std::max<int64_t>(minBytes, 1));
+        double step = points > 1 ? std::pow(static_cast<double>(maxBytes) / size, 1.0 / (points - 1)) : 1;
+        for (size_t i = 0; i < points; ++i, size *= step)
+        {
+            int64_t bytes = i + 1 == points ? maxBytes : static_cast<int64_t>(size);
+            result.push_back(std::make_pair(bytes, hitRatio(bytes)));
+        }
+        return result;
+    }
+
+    /**
+     * @brief decay multiplies what was seen so far by factor (0 forgets it), so the curve follows the
+     * workload of the last hours rather than of the whole life of the process
+     */
+    void decay(double factor)
+    {
+        for (auto &bytes : mHitBytes)
+            bytes *= factor;
+        for (auto &count : mHitCount)
+            count *= factor;
+        mColdBytes *= factor;
+        mColdCount *= factor;
+        mSeenBytes *= factor;
+        mSeenCount *= factor;
+    }
+
+    double sampleRate() const
+    {
+        return mSampler.rate();
+    }
+
+    // updates seen since the start, decay leaves it alone
+    uint64_t updates() const
+    {
+        return mUpdates;
+    }
+
+    size_t trackedKeys() const
+    {
+        return mKeys.size();
+    }
+
+    // memory used: fixed by maxKeys
+    int64_t memoryBytes() const
+    {
+        return static_cast<int64_t>(mFenwick.size() * sizeof(int64_t) + sizeof(mHitBytes) + sizeof(mHitCount)
+                                    + mMaxKeys * (sizeof(Key) + sizeof(uint64_t) + 64 + 48));
+    }
+};
+
+#endif // LRU_MRC_H
@@ -0,0 +1,342 @@
+#ifndef LRU_POLICY_H
+#define LRU_POLICY_H
+
+#include "lru_sampling.h"
+#include <list>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief LRUPolicy how cleanup picks its victims
+ * LRU: least recently updated first.
+ * SizeThenLRU: elements not updated for thresholdSec seconds go first, biggest first (as LRUCacheSizeOrder),
+ * then the others least recently updated first.
+ */
+struct LRUPolicy
+{
+    enum Kind
+    {
+        LRU,
+        SizeThenLRU
+    };
+
+    Kind kind = LRU;
+    int64_t thresholdSec = 0;
+
+    static LRUPolicy lru()
+    {
+        return LRUPolicy();
+    }
+
+    static LRUPolicy sizeThenLRU(int64_t thresholdSec)
+    {
+        LRUPolicy policy;
+        policy.kind = SizeThenLRU;
+        policy.thresholdSec = thresholdSec;
+        return policy;
+    }
+
+    bool operator==(const LRUPolicy &other) const
+    {
+        return kind == other.kind && (kind == LRU || thresholdSec == other.thresholdSec);
+    }
+
+    bool operator!=(const LRUPolicy &other) const
+    {
+        return !(*this == other);
+    }
+
+    std::string name() const
+    {
+        return kind == LRU ? "lru" : "size-then-lru(" + std::to_string(thresholdSec) + "s)";
+    }
+};
+
+/**
+ * @brief LRUShadowCache ghost of a cache running one policy over the sampled keys: key hashes, sizes and
+ * access times only, no elements. Its capacity is the real soft limit scaled by the sampling rate,
+ * it evicts down to it after every access and counts the bytes of accesses it would have hit or missed.
+ */
+class LRUShadowCache
+{
+private:
+    struct Entry
+    {
+        uint64_t key;
+        int64_t size;
+        int64_t accessTime;
+        bool old; // in mOldBySize
+    };
+    typedef std::list<Entry>::iterator EntryItr;
+
+    LRUPolicy mPolicy;
+    int64_t mCapacity;
+    int64_t mTotalSize = 0;
+    std::list<Entry> mList; //least recently updated first
+    std::unordered_map<uint64_t, EntryItr> mMap;
+    std::set<std::pair<int64_t, uint64_t>, std::greater<std::pair<int64_t, uint64_t>>> mOldBySize; //biggest first
+    EntryItr mFirstYoung; //entries before it are old (SizeThenLRU)
+
+    void unlink(EntryItr itr)
+    {
+        if (itr->old)
+            mOldBySize.erase(std::make_pair(itr->size, itr->key));
+        if (itr == mFirstYoung)
+            ++mFirstYoung;
+        mTotalSize -= itr->size;
+        mMap.erase(itr->key);
+        mList.erase(itr);
+    }
+
+    void evict(int64_t now)
+    {
+        if (mPolicy.kind == LRUPolicy::SizeThenLRU)
+        {
+            for (; mFirstYoung != mList.end() && now - mFirstYoung->accessTime >= mPolicy.thresholdSec; ++mFirstYoung)
+            {
+                mFirstYoung->old = true;
+                mOldBySize.insert(std::make_pair(mFirstYoung->size, mFirstYoung->key));
+            }
+        }
+        while (mTotalSize > mCapacity && !mList.empty())
+        {
+            unlink(mOldBySize.empty() ? mList.begin() : mMap[mOldBySize.begin()->second]);
+        }
+    }
+
+public:
+    LRUShadowCache(const LRUPolicy &policy, int64_t capacity)
+        : mPolicy(policy), mCapacity(capacity), mFirstYoung(mList.end())
+    { }
+
+    LRUShadowCache(const LRUShadowCache &) = delete;
+    LRUShadowCache &operator=(const LRUShadowCache &) = delete;
+
+    const LRUPolicy &policy() const
+    {
+        return mPolicy;
+    }
+
+    void setCapacity(int64_t capacity)
+    {
+        mCapacity = capacity;
+    }
+
+    /**
+     * @brief access an update of key: a hit if the policy would still hold it, then it is the most recent
+     * @return true on a hit
+     */
+    bool access(uint64_t key, int64_t size, int64_t now)
+    {
+        auto itrMap = mMap.find(key);
+        bool hit = itrMap != mMap.end();
+        if (hit)
+            unlink(itrMap->second);
+
+        mList.push_back(Entry{key, size, now, false});
+        mMap[key] = std::prev(mList.end());
+        mTotalSize += size;
+        if (mFirstYoung == mList.end())
+            mFirstYoung = std::prev(mList.end());
+
+        evict(now);
+        return hit;
+    }
+
+    void remove(uint64_t key)
+    {
+        auto itrMap = mMap.find(key);
+        if (itrMap != mMap.end())
+            unlink(itrMap->second);
+    }
+
+    size_t entries() const
+    {
+        return mList.size();
+    }
+};
+
+/**
+ * @brief LRUPolicyStats what a LRUPolicySelector saw, hit ratios are byte hit ratios
+ */
+struct LRUPolicyStats
+{
+    std::vector<LRUPolicy> candidates;
+    std::vector<double> lastEpochHitRatio;  // of each candidate in the last complete epoch
+    std::vector<double> totalHitRatio;      // of each candidate since the start
+    size_t live = 0;                        // index of the policy the cache runs
+    int64_t switches = 0;
+    int64_t sampledAccesses = 0;
+    int64_t shadowEntries = 0;              // all shadows together
+    int64_t shadowBytes = 0;                // estimate of the memory they use
+};
+
+/**
+ * @brief LRUPolicySelector runs a shadow cache per candidate policy on the sampled keys and tells the cache
+ * which one to run. Every epochAccesses sampled accesses the byte hit ratios of that epoch are compared:
+ * the best candidate replaces the live one only if it beats it by margin, epochsToSwitch epochs in a row
+ * (hysteresis, so noise or a short burst does not make the cache flip back and forth).
+ * Memory: LRUPolicyStats::shadowBytes, ~100 bytes per sampled key per candidate, e.g. 1/128 of the keys and 2 candidates
+ * is ~1.6 bytes per cached key, well under 1% of what a cached element (its map and list nodes) costs.
+ */
+class LRUPolicySelector
+{
+public:
+    struct Options
+    {
+        double sampleRate = 1.0 / 128;
+        int64_t epochAccesses = 10000;  // sampled accesses per comparison
+        double margin = 0.02;           // byte hit ratio points a challenger must win by
+        int epochsToSwitch = 2;         // epochs in a row it must win
+    };
+
+    // rough size of a shadow entry: list node, hash map node and bucket, sometimes a set node
+    static constexpr int64_t kEntryBytes = 100;
+
+private:
+    struct Candidate
+    {
+        std::unique_ptr<LRUShadowCache> shadow;
+        int64_t epochHitBytes = 0;
+        int64_t epochMissBytes = 0;
+        int64_t totalHitBytes = 0;
+        int64_t totalMissBytes = 0;
+        double lastEpochHitRatio = 0;
+    };
+
+    Options mOptions;
+    LRUKeySampler mSampler;
+    std::vector<Candidate> mCandidates;
+    size_t mLive = 0;
+    size_t mChallenger = 0;
+    int mChallengerEpochs = 0;
+    int64_t mEpochAccesses = 0;
+    int64_t mSampledAccesses = 0;
+    int64_t mSwitches = 0;
+
+    static double hitRatio(int64_t hitBytes, int64_t missBytes)
+    {
+        return hitBytes + missBytes > 0 ? static_cast<double>(hitBytes) / (hitBytes + missBytes) : 0;
+    }
+
+    void endEpoch()
+    {
+        for (auto &candidate : mCandidates)
+        {
+            candidate.lastEpochHitRatio = hitRatio(candidate.epochHitBytes, candidate.epochMissBytes);
+            candidate.epochHitBytes = candidate.epochMissBytes = 0;
+        }
+        mEpochAccesses = 0;
+
+        size_t best = mLive;
+        for (size_t i = 0; i < mCandidates.size(); ++i)
+        {
+            if (mCandidates[i].lastEpochHitRatio > mCandidates[best].lastEpochHitRatio)
+                best = i;
+        }
+
+        if (best == mLive || mCandidates[best].lastEpochHitRatio < mCandidates[mLive].lastEpochHitRatio + mOptions.margin)
+        {
+            mChallengerEpochs = 0;
+            return;
+        }
+        mChallengerEpochs = best == mChallenger ? mChallengerEpochs + 1 : 1;
+        mChallenger = best;
+        if (mChallengerEpochs >= mOptions.epochsToSwitch)
+        {
+            mLive = best;
+            mChallengerEpochs = 0;
+            mSwitches++;
+        }
+    }
+
+public:
+    /**
+     * @param candidates policies to compare, the first one is live at the start
+     * @param softLimit soft limit (bytes) of the real cache
+     */
+    LRUPolicySelector(const std::vector<LRUPolicy> &candidates, int64_t softLimit, const Options &options)
+        : mOptions(options), mSampler(options.sampleRate)
+    {
+        for (const auto &policy : candidates)
+        {
+            Candidate candidate;
+            candidate.shadow.reset(new LRUShadowCache(policy, 0));
+            mCandidates.push_back(std::move(candidate));
+        }
+        setSoftLimit(softLimit);
+    }
+
+    void setSoftLimit(int64_t softLimit)
+    {
+        for (auto &candidate : mCandidates)
+            candidate.shadow->setCapacity(static_cast<int64_t>(softLimit * mSampler.rate()));
+    }
+
+    /**
+     * @brief access an update of the key of hash keyHash (lruKeyHash)
+     * @return true when the live policy changed
+     */
+    bool access(uint64_t keyHash, int64_t size, int64_t now)
+    {
+        if (!mSampler.sampled(keyHash))
+            return false;
+
+        for (auto &candidate : mCandidates)
+        {
+            if (candidate.shadow->access(keyHash, size, now))
+            {
+                candidate.epochHitBytes += size;
+                candidate.totalHitBytes += size;
+            }
+            else
+            {
+                candidate.epochMissBytes += size;
+                candidate.totalMissBytes += size;
+            }
+        }
+        mSampledAccesses++;
+
+        size_t live = mLive;
+        if (++mEpochAccesses >= mOptions.epochAccesses)
+            endEpoch();
+        return live != mLive;
+    }
+
+    // a key removed on purpose (not evicted) leaves the shadows too
+    void remove(uint64_t keyHash)
+    {
+        if (!mSampler.sampled(keyHash))
+            return;
+        for (auto &candidate : mCandidates)
+            candidate.shadow->remove(keyHash);
+    }
+
+    const LRUPolicy &livePolicy() const
+    {
+        return mCandidates[mLive].shadow->policy();
+    }
+
+    LRUPolicyStats stats() const
+    {
+        LRUPolicyStats stats;
+        for (const auto &candidate : mCandidates)
+        {
+            stats.candidates.push_back(candidate.shadow->policy());
+            stats.lastEpochHitRatio.push_back(candidate.lastEpochHitRatio);
+            stats.totalHitRatio.push_back(hitRatio(candidate.totalHitBytes, candidate.totalMissBytes));
+            stats.shadowEntries += candidate.shadow->entries();
+        }
+        stats.live = mLive;
+        stats.switches = mSwitches;
+        stats.sampledAccesses = mSampledAccesses;
+        stats.shadowBytes = stats.shadowEntries * kEntryBytes;
+        return stats;
+    }
+};
+
+#endif // LRU_POLICY_H
@@ -0,0 +1,89 @@
+#ifndef LRU_SAMPLING_H
+#define LRU_SAMPLING_H
+
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief lruIsHashable true when std::hash<PK> can hash PK: only the features working on key hashes
+ * (samplers, shadow caches, curves, ghosts) need it, a cache of keys with only operator< works without them
+ */
+template <typename PK, typename = void>
+struct lruIsHashable : std::false_type
+{ };
+
+template <typename PK>
+struct lruIsHashable<PK, decltype(void(std::declval<const std::hash<PK> &>()(std::declval<const PK &>())))>
+    : std::is_default_constructible<std::hash<PK>>
+{ };
+
+/**
+ * @brief lruKeyHash 64-bit hash of a cache key: std::hash<PK> through the splitmix64 finalizer,
+ * so identity hashes (integers) still spread over all the bits the samplers look at
+ */
+template <typename PK>
+uint64_t lruKeyHash(const PK &key)
+{
+    uint64_t h = static_cast<uint64_t>(std::hash<PK>()(key));
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+/**
+ * @brief LRUKeySampler spatial sampling of keys (as in SHARDS): a key is in the sample when the low
+ * 24 bits of its hash are below rate * 2^24. Every access of a sampled key is seen, the others never,
+ * so reuse patterns survive the sampling, and the same keys are picked in every cache and every run.
+ */
+class LRUKeySampler
+{
+public:
+    static constexpr uint64_t kModulus = uint64_t(1) << 24;
+
+private:
+    uint64_t mThreshold;
+
+public:
+    explicit LRUKeySampler(double rate = 1.0)
+    {
+        setRate(rate);
+    }
+
+    bool sampled(uint64_t hash) const
+    {
+        return (hash & (kModulus - 1)) < mThreshold;
+    }
+
+    // position of a hash in the sampling space, a sampler lowering its threshold drops the keys above it
+    static uint64_t position(uint64_t hash)
+    {
+        return hash & (kModulus - 1);
+    }
+
+    double rate() const
+    {
+        return static_cast<double>(mThreshold) / kModulus;
+    }
+
+    void setRate(double rate)
+    {
+        mThreshold = rate >= 1.0 ? kModulus : (rate <= 0.0 ? 0 : static_cast<uint64_t>(rate * kModulus));
+    }
+
+    uint64_t threshold() const
+    {
+        return mThreshold;
+    }
+
+    void setThreshold(uint64_t threshold)
+    {
+        mThreshold = threshold;
+    }
+};
+
+#endif // LRU_SAMPLING_H
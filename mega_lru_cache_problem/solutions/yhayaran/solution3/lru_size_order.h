@@ -1,3 +1,6 @@
+#ifndef LRU_SIZE_ORDER_H
+#define LRU_SIZE_ORDER_H
+
 #include "lru.h"
 #include <iostream>
 
@@ -156,6 +159,12 @@ protected:
                 typename std::list<SPTR_CACHE_ELEMENT>::iterator,
                 CompareSizePKPair> _mapOfElementsOrderSize;
 
+    /**
+     * @brief Link handed to the size observers, cut when the cache is destroyed.
+     */
+    std::shared_ptr<LRUSizeObserverLink<LRUCacheSizeOrder, PK>> _SizeObserverLink = 
+        std::make_shared<LRUSizeObserverLink<LRUCacheSizeOrder, PK>>(this);
+
     /**
      * @brief Threshold checking thread object.
      */    
@@ -265,6 +274,7 @@ protected:
 public:
     virtual ~LRUCacheSizeOrder()
     {
+        _SizeObserverLink->detach();
         end();
 
         if(_CleanerThread)
@@ -334,7 +344,7 @@ public:
         // references from internal map and list be removed but the element is still holds the memory. 
         // I am bit confused here, may be we can discuss about that. 
         // In original LRUCache implemention there is no such condition.
-        if(size <= _nHardLimitInBytes)
+        if((int64_t)size <= _nHardLimitInBytes)
         {
             {
                 std::lock_guard<std::mutex> B(_mutexForElementAccess);
@@ -382,6 +392,88 @@ public:
         }
     }
 
+    /**
+     * @brief resize function to change the size of an element without changing its access time,
+     * so it keeps its place in the list of elements. 
+     * If the element is already in the size wise map, it is moved to the position of its new size.
+     * 
+     * @param key 
+     * @param size 
+     * @return false if the key is not in the cache
+     */
+    virtual bool resize(const PK& key, size_t size)
+    {
+        {
+            std::lock_guard<std::mutex> R(_mutexForElementAccess);
+
+            auto itrMap = _mapOfPKWithElement.find(key);
+            if (itrMap == _mapOfPKWithElement.end())
+            {
+                return false;
+            }
+
+            SPTR_CACHE_ELEMENT cacheElement = itrMap->second;
+            _nTotalSizeOfCache += (int64_t)size - cacheElement->size();
+
+            if (cacheElement->getMarkSizeWiseCleanup())
+            {
+                // re-key the size wise map, the old size is part of the key
+                _mapOfElementsOrderSize.erase(SizePKPair(cacheElement->size(), cacheElement->primaryKey()));
+                cacheElement->setSize(size);
+                _mapOfElementsOrderSize.insert(
+                    std::pair<SizePKPair, typename std::list<SPTR_CACHE_ELEMENT>::iterator>
+                    (SizePKPair(cacheElement->size(), cacheElement->primaryKey()), cacheElement->elementInListItr())
+                );
+            }
+            else
+            {
+                cacheElement->setSize(size);
+            }
+        }
+
+        // grown in place above the hard limit, do cleanup
+        if (_nTotalSizeOfCache > _nHardLimitInBytes)
+        {
+            cleanup(&key);
+        }
+        return true;
+    }
+
+    /**
+     * @brief totalSize function to get the bytes of all the cached elements.
+     * 
+     * @return int64_t 
+     */
+    virtual int64_t totalSize()
+    {
+        std::lock_guard<std::mutex> S(_mutexForElementAccess);
+        return _nTotalSizeOfCache;
+    }
+
+    /**
+     * @brief contains function to check if key is cached, without changing its access time.
+     * 
+     * @param key 
+     * @return true if the key is in the cache
+     */
+    virtual bool contains(const PK& key)
+    {
+        std::lock_guard<std::mutex> C(_mutexForElementAccess);
+        return _mapOfPKWithElement.find(key) != _mapOfPKWithElement.end();
+    }
+
+    /**
+     * @brief sizeObserver function to get a handle the element of key can hold 
+     * to report its own size changes (see resize).
+     * 
+     * @param key 
+     * @return std::shared_ptr<LRUSizeObserver> 
+     */
+    virtual std::shared_ptr<LRUSizeObserver> sizeObserver(const PK& key)
+    {
+        return std::make_shared<LRUCacheSizeObserver<LRUCacheSizeOrder, PK>>(_SizeObserverLink, key);
+    }
+
     virtual void cleanup(const PK* keyToSaveFromPurge = nullptr)
     {
         std::cout << std::endl << "*cleanup()*" << std::endl;
@@ -390,56 +482,61 @@ public:
         //  vector of data to clean
         std::vector<std::shared_ptr<LRUCleanable>> toClean;
 
-        // first try to remove the element from the size wise map
-        if(_mapOfElementsOrderSize.size())
+        // first try to remove the element from the size wise map,
+        // the saved key stays there (and cached), marked as it was
+        for (auto itrSize = _mapOfElementsOrderSize.begin(); itrSize != _mapOfElementsOrderSize.end(); )
         {
-            for (auto& el: _mapOfElementsOrderSize)
+            typename std::list<SPTR_CACHE_ELEMENT>::iterator itr = itrSize->second;
+            if (keyToSaveFromPurge && *keyToSaveFromPurge == (*itr)->primaryKey())
             {
-                typename std::list<SPTR_CACHE_ELEMENT>::iterator itr = el.second;
-                auto weakPointerEl = (*itr)->weakPointerElement();
-                auto shrPointerEl = weakPointerEl.lock();
-                if (shrPointerEl)
-                {
-                    toClean.push_back(shrPointerEl);
-                }
-                _nTotalSizeOfCache -= (*itr)->size();
+                ++itrSize;
+                continue;
             }
 
-            _mapOfElementsOrderSize.clear();
+            auto weakPointerEl = (*itr)->weakPointerElement();
+            auto shrPointerEl = weakPointerEl.lock();
+            if (shrPointerEl)
+            {
+                toClean.push_back(shrPointerEl);
+            }
+            _nTotalSizeOfCache -= (*itr)->size();
+            itrSize = _mapOfElementsOrderSize.erase(itrSize);
         }
 
-        // do loop till total number of elements is greater than 0, 
+        // do loop till the end of the list of elements, 
         // and total size is greater than soft limit
-        while (_listOfElements.size() && _nTotalSizeOfCache > _nSoftLimitInBytes)
+        auto itrList = _listOfElements.begin();
+        while (itrList != _listOfElements.end() && _nTotalSizeOfCache > _nSoftLimitInBytes)
         {
-            // take the first element (or say oldest element in the list)
-            auto el = _listOfElements.front();
+            // take the oldest element not yet looked at
+            auto el = *itrList;
 
-            // if the current element is marked for size wise cleanup,
-            // then skip it because we have already considered for cleaning
-                // just pop it out, removes from the list
-            _listOfElements.pop_front();
+            // the saved key (the one updated or resized) keeps its place in the list and the map,
+            // e.g. resize keeps the access time, so it can be the oldest element
+            if (keyToSaveFromPurge && *keyToSaveFromPurge == el->primaryKey())
+            {
+                ++itrList;
+                continue;
+            }
+
+            // removes from the list
+            itrList = _listOfElements.erase(itrList);
 
             // earse from the map of elements (PK, PTR)
             _mapOfPKWithElement.erase(el->primaryKey());
 
+            // if the current element is marked for size wise cleanup,
+            // then skip it because we have already considered for cleaning
             if(!el->getMarkSizeWiseCleanup())
             {
-                // KEY have value OR KEY is NOT key
-                // lets say: PK:3, Hard Limit: 40B, Size of PK:3 == 50B
-                // *keyToSaveFromPurge == 3, el->primaryKey() == 3 (only and last element)
-                if (!keyToSaveFromPurge                     ||  // ENTER: if nullptr
-                    *keyToSaveFromPurge != el->primaryKey() )   // ENTER: if key == current key
+                auto weakPointerEl = el->weakPointerElement();
+                auto shrPointerEl = weakPointerEl.lock();
+                if (shrPointerEl)
                 {
-                    auto weakPointerEl = el->weakPointerElement();
-                    auto shrPointerEl = weakPointerEl.lock();
-                    if (shrPointerEl)
-                    {
-                        toClean.push_back(shrPointerEl);
-                    }
-
-                    _nTotalSizeOfCache -= el->size();
+                    toClean.push_back(shrPointerEl);
                 }
+
+                _nTotalSizeOfCache -= el->size();
             }
         }
 
@@ -454,4 +551,6 @@ public:
         cacheElement->setMarkSizeWiseCleanup(false);
         _mapOfElementsOrderSize.erase(SizePKPair(cacheElement->size(), cacheElement->primaryKey()));
     }
-};
\ No newline at end of file
+};
+
+#endif // LRU_SIZE_ORDER_H
@@ -0,0 +1,134 @@
+#ifndef LRU_TUNING_H
+#define LRU_TUNING_H
+
+#include "lru_mrc.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+/**
+ * @brief LRULimitTuning what a LRULimitTuner aims at and how far it may go.
+ * With both goals set the smaller soft limit wins: the target is met, or memory stops where it buys too few hits.
+ */
+struct LRULimitTuning
+{
+    double targetHitRatio = 0;  // smallest soft limit with this byte hit ratio, 0: no target
+    double minGainPerMB = 0;    // soft limit stops where one more MB adds less byte hit ratio than this, 0: no threshold
+    int64_t minSoft = 0;        // operator bounds of the soft limit
+    int64_t maxSoft = std::numeric_limits<int64_t>::max();
+    double hardOverSoft = 1.25; // hard limit = soft limit * this, at most maxHard
+    int64_t maxHard = std::numeric_limits<int64_t>::max();
+    double damping = 0.25;      // share of the way to the wanted soft limit moved per step
+    double deadband = 0.05;     // moves under this share of the soft limit are not made
+    int64_t minUpdates = 10000; // updates the curve must have seen since the last step
+};
+
+/**
+ * @brief LRULimitTuner picks the limits of a cache from its miss-ratio curve (LRUMissRatioCurve), a step at a time.
+ * The wanted soft limit is read on kPoints sizes log-spaced between the bounds. Each step moves the soft limit a
+ * share (damping) of the way there, so the noise of the curve and workload swings are smoothed over several steps,
+ * and skips moves within the deadband, so a cache that found its size stays there.
+ */
+class LRULimitTuner
+{
+public:
+    static constexpr size_t kPoints = 64;
+
+private:
+    LRULimitTuning mTuning;
+    uint64_t mLastUpdates = 0;
+    int64_t mWanted = 0;
+    int64_t mSteps = 0;
+    int64_t mChanges = 0;
+
+public:
+    explicit LRULimitTuner(const LRULimitTuning &tuning)
+        : mTuning(tuning)
+    { }
+
+    const LRULimitTuning &tuning() const
+    {
+        return mTuning;
+    }
+
+    /**
+     * @brief wantedSoft the soft limit the curve asks for, within the bounds (current when no goal is set)
+     */
+    int64_t wantedSoft(const LRUMissRatioCurve &curve, int64_t current) const
+    {
+        int64_t high = mTuning.maxSoft;
+        int64_t low = std::max<int64_t>(std::max<int64_t>(mTuning.minSoft, high >> 16), 1);
+        if (mTuning.targetHitRatio <= 0 && mTuning.minGainPerMB <= 0)
+            return std::min(high, std::max(low, current));
+
+        auto points = curve.curve(low, high, kPoints);
+        int64_t wanted = high;
+        if (mTuning.targetHitRatio > 0)
+        {
+            for (auto &point : points)
+            {
+                if (point.second >= mTuning.targetHitRatio)
+                {
+                    wanted = point.first;
+                    break;
+                }
+            }
+        }
+        if (mTuning.minGainPerMB > 0)
+        {
+            // the end of the last segment still worth its memory: a plateau before a cliff does not stop it
+            int64_t knee = points.front().first;
+            for (size_t i = 0; i + 1 < points.size(); ++i)
+            {
+                double mb = static_cast<double>(points[i + 1].first - points[i].first) / (1 << 20);
+                if (mb > 0 && (points[i + 1].second - points[i].second) / mb >= mTuning.minGainPerMB)
+                    knee = points[i + 1].first;
+            }
+            wanted = std::min(wanted, knee);
+        }
+        return std::min(high, std::max(low, wanted));
+    }
+
+    /**
+     * @brief step moves soft and hard towards what the curve asks for, once minUpdates updates were seen since the last step
+     * @return true when they changed
+     */
+    bool step(const LRUMissRatioCurve &curve, int64_t &soft, int64_t &hard)
+    {
+        if (curve.updates() - mLastUpdates < static_cast<uint64_t>(mTuning.minUpdates))
+            return false;
+        mLastUpdates = curve.updates();
+        mSteps++;
+
+        mWanted = wantedSoft(curve, soft);
+        int64_t next = soft + static_cast<int64_t>(mTuning.damping * static_cast<double>(mWanted - soft));
+        next = std::min(mTuning.maxSoft, std::max(mTuning.minSoft, next));
+        if (next == soft || std::abs(static_cast<double>(next - soft)) < mTuning.deadband * static_cast<double>(soft))
+            return false;
+
+        soft = next;
+        double scaledHard = static_cast<double>(soft) * mTuning.hardOverSoft;
+        hard = scaledHard >= static_cast<double>(mTuning.maxHard) ? mTuning.maxHard : static_cast<int64_t>(scaledHard);
+        hard = std::max(hard, soft);
+        mChanges++;
+        return true;
+    }
+
+    // soft limit the last step aimed at
+    int64_t wanted() const
+    {
+        return mWanted;
+    }
+
+    int64_t steps() const
+    {
+        return mSteps;
+    }
+
+    int64_t changes() const
+    {
+        return mChanges;
+    }
+};
+
+#endif // LRU_TUNING_H
@@ -1,174 +1,715 @@
 /*
-*   Description:            Class to match the basic features of std::string
-*                           Strings represents the sequence of characters.
-*   Features Supported:     1. String constuction/destruction.
-*                           2. length function to count number of characters. 
-*                           3. append function to
-*                           4. + operator to join two strings.
-*                           5. find function to find the set of characters or string (shorter) within 
-*                              string.
+*   Description:            Search and hash kernels of stringType (see stringType.h).
+*                           SSE2 and AVX2 versions are compiled with target attributes, the best one
+*                           the CPU supports is picked once, at the first call. Other CPUs use scalar ones.
+*                           AVX2 kernels finish with the SSE2 ones after _mm256_zeroupper: legacy SSE code
+*                           running with dirty upper halves pays a state transition per instruction.
+*                           Character search compares 16/32 characters at once (like memchr).
+*                           Substring search is the "generic SIMD" one: compare the first and the last
+*                           character of the needle at 16/32 positions at once, memcmp only the candidates.
+*                           Byte set search (any of the delimiters): one vpshufb lookup per nibble for 32 characters
+*                           (AVX2), one compare per member for up to 8 of them (SSE2), a bitmap otherwise.
+*                           Mismatch (the compare kernel) checks 16/32 characters per step, 64 while they match.
+*                           stringTypeHash is wyhash: 8/16 bytes per 64x64->128 multiply, no SIMD needed.
+*                           Also stringType::mapFile (mmap, POSIX).
 */
-#include <iostream>
-#include <exception>
+#include "stringType.h"
+#include <cstdlib>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-class stringType
+#if defined(__x86_64__) || defined(__i386__)
+#define STRING_TYPE_X86
+#include <immintrin.h>
+#endif
+
+typedef size_t (*FindCharKernel)(const char*, size_t, char);
+typedef size_t (*FindKernel)(const char*, size_t, const char*, size_t);
+typedef size_t (*MismatchKernel)(const char*, const char*, size_t);
+typedef size_t (*FindAnyOfKernel)(const char*, size_t, const stringTypeByteSet&);
+
+struct stringTypeKernels
+{
+    const char* pName;
+    FindCharKernel findChar;
+    FindCharKernel rfindChar;
+    FindKernel find;        // nNeedle in [1, nHaystack]
+    FindKernel rfind;       // nNeedle in [1, nHaystack]
+    MismatchKernel mismatch;
+    FindAnyOfKernel findAnyOf;
+};
+
+static size_t findCharScalar(const char* pHaystack, size_t nHaystack, char cNeedle)
 {
-    public:
-        stringType() : _pSeqOfChars(nullptr), _nSizeInBytes(0), _nLength(0)
-        { }
+    const void* pFound = memchr(pHaystack, cNeedle, nHaystack);
+    return pFound != nullptr ? static_cast<size_t>(static_cast<const char*>(pFound) - pHaystack) : stringTypeNpos;
+}
 
-        stringType(const char* pSeqOfChars) : _pSeqOfChars(nullptr), _nSizeInBytes(0), _nLength(0)
-        { 
-            _copyFromCharPointer(pSeqOfChars);
+static size_t rfindCharScalar(const char* pHaystack, size_t nHaystack, char cNeedle)
+{
+    for (size_t i = nHaystack; i-- > 0; )
+    {
+        if (pHaystack[i] == cNeedle)
+        {
+            return i;
         }
+    }
+    return stringTypeNpos;
+}
+
+static size_t findScalar(const char* pHaystack, size_t nHaystack, const char* pNeedle, size_t nNeedle)
+{
+    if (nNeedle > nHaystack)
+    {
+        return stringTypeNpos;
+    }
 
-        stringType(const stringType& stringObj)
+    size_t nLastStart = nHaystack - nNeedle;
+    size_t i = 0;
+    while (i <= nLastStart)
+    {
+        size_t nFound = findCharScalar(pHaystack + i, nLastStart - i + 1, pNeedle[0]);
+        if (nFound == stringTypeNpos)
+        {
+            return stringTypeNpos;
+        }
+        i += nFound;
+        if (memcmp(pHaystack + i + 1, pNeedle + 1, nNeedle - 1) == 0)
         {
-            _copyFromStringType(stringObj);
+            return i;
         }
+        ++i;
+    }
+    return stringTypeNpos;
+}
 
-        void operator= (const stringType& stringObj)
+static size_t rfindScalar(const char* pHaystack, size_t nHaystack, const char* pNeedle, size_t nNeedle)
+{
+    if (nNeedle > nHaystack)
+    {
+        return stringTypeNpos;
+    }
+
+    for (size_t i = nHaystack - nNeedle + 1; i-- > 0; )
+    {
+        if (pHaystack[i] == pNeedle[0] && memcmp(pHaystack + i + 1, pNeedle + 1, nNeedle - 1) == 0)
         {
-            clear();
-            _copyFromStringType(stringObj);
+            return i;
         }
+    }
+    return stringTypeNpos;
+}
 
-        void operator= (const char* pSeqOfChars)
+// 8 characters per step: the lowest set byte of the xor is the first difference (little endian)
+static size_t mismatchScalar(const char* pLeft, const char* pRight, size_t nLength)
+{
+    size_t i = 0;
+    for (; i + 8 <= nLength; i += 8)
+    {
+        uint64_t nLeft;
+        uint64_t nRight;
+        memcpy(&nLeft, pLeft + i, sizeof(nLeft));
+        memcpy(&nRight, pRight + i, sizeof(nRight));
+        if (nLeft != nRight)
         {
-            clear();
-            _copyFromCharPointer(pSeqOfChars);
+            return i + (__builtin_ctzll(nLeft ^ nRight) >> 3);
         }
+    }
+    for (; i < nLength; ++i)
+    {
+        if (pLeft[i] != pRight[i])
+        {
+            return i;
+        }
+    }
+    return nLength;
+}
 
-        stringType operator+ (const stringType& strData)
+static size_t findAnyOfScalar(const char* pHaystack, size_t nHaystack, const stringTypeByteSet& setOfBytes)
+{
+    for (size_t i = 0; i < nHaystack; ++i)
+    {
+        if (setOfBytes.contains(pHaystack[i]))
         {
-            stringType strResult;
+            return i;
+        }
+    }
+    return stringTypeNpos;
+}
 
-            strResult.append(*this);
-            strResult.append(strData);
+#ifdef STRING_TYPE_X86
 
-            return  strResult;
+__attribute__((target("sse2")))
+static size_t findCharSse2(const char* pHaystack, size_t nHaystack, char cNeedle)
+{
+    const __m128i needle = _mm_set1_epi8(cNeedle);
+    size_t i = 0;
+    for (; i + 16 <= nHaystack; i += 16)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pHaystack + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+        if (mask)
+        {
+            return i + __builtin_ctz(mask);
         }
+    }
+    size_t nFound = findCharScalar(pHaystack + i, nHaystack - i, cNeedle);
+    return nFound == stringTypeNpos ? stringTypeNpos : i + nFound;
+}
 
-        virtual ~stringType()
-        { 
-            clear(); 
+__attribute__((target("sse2")))
+static size_t rfindCharSse2(const char* pHaystack, size_t nHaystack, char cNeedle)
+{
+    const __m128i needle = _mm_set1_epi8(cNeedle);
+    size_t i = nHaystack;
+    while (i >= 16)
+    {
+        i -= 16;
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pHaystack + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+        if (mask)
+        {
+            return i + 31 - __builtin_clz(mask);
         }
+    }
+    return rfindCharScalar(pHaystack, i, cNeedle);
+}
 
-        virtual void append(const char* pSeqOfChars)
+__attribute__((target("sse2")))
+static size_t findSse2(const char* pHaystack, size_t nHaystack, const char* pNeedle, size_t nNeedle)
+{
+    if (nNeedle == 1)
+    {
+        return findCharSse2(pHaystack, nHaystack, pNeedle[0]);
+    }
+
+    const __m128i first = _mm_set1_epi8(pNeedle[0]);
+    const __m128i last = _mm_set1_epi8(pNeedle[nNeedle - 1]);
+    size_t nStarts = nHaystack - nNeedle + 1;
+    size_t i = 0;
+    for (; i + 16 <= nStarts; i += 16)
+    {
+        __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pHaystack + i));
+        __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pHaystack + i + nNeedle - 1));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last))));
+        while (mask)
         {
-            if(pSeqOfChars != nullptr)
+            unsigned nBit = __builtin_ctz(mask);
+            if (memcmp(pHaystack + i + nBit + 1, pNeedle + 1, nNeedle - 2) == 0)
             {
-                size_t nLenOfNewString = strlen(pSeqOfChars);
-                if(nLenOfNewString > 0)
-                {
-                    size_t nNewSize = _nLength + nLenOfNewString + 1;
-                    char* pBiggerString = new char[nNewSize];
-
-                    if(_nLength > 0 && _pSeqOfChars != nullptr)
-                    {
-                        memcpy(pBiggerString, _pSeqOfChars, _nLength);
-                        clear();
-                    }
-
-                    memcpy(pBiggerString + (nNewSize - nLenOfNewString - 1), pSeqOfChars, nLenOfNewString);
-                    
-                    // reset all
-                    _pSeqOfChars = pBiggerString;
-                    _nSizeInBytes = nNewSize;
-                    _nLength = nNewSize - 1;
-
-                    _pSeqOfChars[_nSizeInBytes] = '\0';
-                }
+                return i + nBit;
             }
+            mask &= mask - 1;
         }
+    }
+    size_t nFound = findScalar(pHaystack + i, nHaystack - i, pNeedle, nNeedle);
+    return nFound == stringTypeNpos ? stringTypeNpos : i + nFound;
+}
+
+__attribute__((target("sse2")))
+static size_t rfindSse2(const char* pHaystack, size_t nHaystack, const char* pNeedle, size_t nNeedle)
+{
+    if (nNeedle == 1)
+    {
+        return rfindCharSse2(pHaystack, nHaystack, pNeedle[0]);
+    }
 
-        virtual void append(const stringType& strData)
+    const __m128i first = _mm_set1_epi8(pNeedle[0]);
+    const __m128i last = _mm_set1_epi8(pNeedle[nNeedle - 1]);
+    size_t i = nHaystack - nNeedle + 1;
+    while (i >= 16)
+    {
+        i -= 16;
+        __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pHaystack + i));
+        __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pHaystack + i + nNeedle - 1));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last))));
+        while (mask)
         {
-            if(strData._pSeqOfChars != nullptr && strData._nLength > 0)
+            unsigned nBit = 31 - __builtin_clz(mask);
+            if (memcmp(pHaystack + i + nBit + 1, pNeedle + 1, nNeedle - 2) == 0)
             {
-                    size_t nNewSize = _nLength + strData._nLength + 1;
-                    char* pBiggerString = new char[nNewSize];
-
-                    if(_nLength > 0 && _pSeqOfChars != nullptr)
-                    {
-                        memcpy(pBiggerString, _pSeqOfChars, _nLength);
-                        clear();
-                    }
-
-                    memcpy(pBiggerString + (nNewSize - strData._nLength - 1), strData._pSeqOfChars, strData._nLength);
-                    
-                    // reset all
-                    _pSeqOfChars = pBiggerString;
-                    _nSizeInBytes = nNewSize;
-                    _nLength = nNewSize - 1;
-
-                    _pSeqOfChars[_nSizeInBytes] = '\0';
+                return i + nBit;
             }
+            mask &= ~(1u << nBit);
         }
+    }
+    // starts left are [0, i)
+    return rfindScalar(pHaystack, i + nNeedle - 1, pNeedle, nNeedle);
+}
 
-        void clear()
+__attribute__((target("sse2")))
+static size_t mismatchSse2(const char* pLeft, const char* pRight, size_t nLength)
+{
+    size_t i = 0;
+    for (; i + 16 <= nLength; i += 16)
+    {
+        __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pLeft + i));
+        __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRight + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(left, right)));
+        if (mask != 0xFFFF)
         {
-            if(_nSizeInBytes > 0)
-            {
-                if(_pSeqOfChars != nullptr)
-                { 
-                    delete[] _pSeqOfChars;
-                    _pSeqOfChars    = nullptr;
-                    _nSizeInBytes   = 0;
-                    _nLength        = 0;
-                }
-            }
+            return i + __builtin_ctz(~mask);
         }
+    }
+    return i + mismatchScalar(pLeft + i, pRight + i, nLength - i);
+}
+
+// a compare per member: worth it for the usual few delimiters, the bitmap beyond 8
+__attribute__((target("sse2")))
+static size_t findAnyOfSse2(const char* pHaystack, size_t nHaystack, const stringTypeByteSet& setOfBytes)
+{
+    size_t nBytes = setOfBytes.nBytes;
+    if (nBytes > sizeof(setOfBytes.aBytes))
+    {
+        return findAnyOfScalar(pHaystack, nHaystack, setOfBytes);
+    }
+    __m128i members[sizeof(setOfBytes.aBytes)];
+    for (size_t k = 0; k < nBytes; ++k)
+    {
+        members[k] = _mm_set1_epi8(setOfBytes.aBytes[k]);
+    }
 
-        size_t size()
+    size_t i = 0;
+    for (; i + 16 <= nHaystack; i += 16)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pHaystack + i));
+        __m128i found = _mm_cmpeq_epi8(block, members[0]);
+        for (size_t k = 1; k < nBytes; ++k)
         {
-            return _nSizeInBytes;
+            found = _mm_or_si128(found, _mm_cmpeq_epi8(block, members[k]));
         }
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(found));
+        if (mask)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    size_t nFound = findAnyOfScalar(pHaystack + i, nHaystack - i, setOfBytes);
+    return nFound == stringTypeNpos ? stringTypeNpos : i + nFound;
+}
 
-        size_t length()
+__attribute__((target("avx2")))
+static size_t findCharAvx2(const char* pHaystack, size_t nHaystack, char cNeedle)
+{
+    const __m256i needle = _mm256_set1_epi8(cNeedle);
+    size_t i = 0;
+    for (; i + 64 <= nHaystack; i += 64)
+    {
+        __m256i eq0 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pHaystack + i)), needle);
+        __m256i eq1 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pHaystack + i + 32)), needle);
+        if (!_mm256_testz_si256(_mm256_or_si256(eq0, eq1), _mm256_or_si256(eq0, eq1)))
         {
-            return _nLength;
+            break;
         }
+    }
+    for (; i + 32 <= nHaystack; i += 32)
+    {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pHaystack + i));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+        if (mask)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper();
+    size_t nFound = findCharSse2(pHaystack + i, nHaystack - i, cNeedle);
+    return nFound == stringTypeNpos ? stringTypeNpos : i + nFound;
+}
 
-        const char* c_str()
+__attribute__((target("avx2")))
+static size_t rfindCharAvx2(const char* pHaystack, size_t nHaystack, char cNeedle)
+{
+    const __m256i needle = _mm256_set1_epi8(cNeedle);
+    size_t i = nHaystack;
+    while (i >= 32)
+    {
+        i -= 32;
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pHaystack + i));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+        if (mask)
         {
-            return _pSeqOfChars;
+            return i + 31 - __builtin_clz(mask);
         }
+    }
+    _mm256_zeroupper();
+    return rfindCharSse2(pHaystack, i, cNeedle);
+}
 
-    protected:
-        char* _pSeqOfChars;
-        size_t _nSizeInBytes;
-        size_t _nLength;
+__attribute__((target("avx2")))
+static size_t findAvx2(const char* pHaystack, size_t nHaystack, const char* pNeedle, size_t nNeedle)
+{
+    if (nNeedle == 1)
+    {
+        return findCharAvx2(pHaystack, nHaystack, pNeedle[0]);
+    }
 
-        void _copyFromCharPointer(const char* pSeqOfChars)
+    const __m256i first = _mm256_set1_epi8(pNeedle[0]);
+    const __m256i last = _mm256_set1_epi8(pNeedle[nNeedle - 1]);
+    size_t nStarts = nHaystack - nNeedle + 1;
+    size_t i = 0;
+    // 64 starts per round while nothing matches, to stay close to memory bandwidth
+    for (; i + 64 <= nStarts; i += 64)
+    {
+        const char* pBlock = pHaystack + i;
+        __m256i eq0 = _mm256_and_si256(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBlock)), first),
+            _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBlock + nNeedle - 1)), last));
+        __m256i eq1 = _mm256_and_si256(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBlock + 32)), first),
+            _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBlock + 32 + nNeedle - 1)), last));
+        if (!_mm256_testz_si256(_mm256_or_si256(eq0, eq1), _mm256_or_si256(eq0, eq1)))
         {
-            if (pSeqOfChars != nullptr)
+            break; // candidates, checked one by one below
+        }
+    }
+    for (; i + 32 <= nStarts; i += 32)
+    {
+        __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pHaystack + i));
+        __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pHaystack + i + nNeedle - 1));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last))));
+        while (mask)
+        {
+            unsigned nBit = __builtin_ctz(mask);
+            if (memcmp(pHaystack + i + nBit + 1, pNeedle + 1, nNeedle - 2) == 0)
             {
-                size_t nLength = strlen(pSeqOfChars);
-                if(nLength > 0)
-                {
-                    _nLength = nLength;
-                    _nSizeInBytes = _nLength + 1;
-
-                    // new operator throws the std::bad_alloc excpetion in case of low memory
-                    _pSeqOfChars = new char[_nSizeInBytes];
-                    memcpy(_pSeqOfChars, pSeqOfChars, _nLength);
-                    _pSeqOfChars[_nLength] = '\0';
-                }
+                return i + nBit;
             }
+            mask &= mask - 1;
         }
+    }
+    _mm256_zeroupper();
+    size_t nFound = findSse2(pHaystack + i, nHaystack - i, pNeedle, nNeedle);
+    return nFound == stringTypeNpos ? stringTypeNpos : i + nFound;
+}
+
+__attribute__((target("avx2")))
+static size_t rfindAvx2(const char* pHaystack, size_t nHaystack, const char* pNeedle, size_t nNeedle)
+{
+    if (nNeedle == 1)
+    {
+        return rfindCharAvx2(pHaystack, nHaystack, pNeedle[0]);
+    }
 
-        void _copyFromStringType(const stringType& strData)
+    const __m256i first = _mm256_set1_epi8(pNeedle[0]);
+    const __m256i last = _mm256_set1_epi8(pNeedle[nNeedle - 1]);
+    size_t i = nHaystack - nNeedle + 1;
+    while (i >= 32)
+    {
+        i -= 32;
+        __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pHaystack + i));
+        __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pHaystack + i + nNeedle - 1));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last))));
+        while (mask)
         {
-            if (strData._nSizeInBytes > 0 && strData._pSeqOfChars != nullptr)
+            unsigned nBit = 31 - __builtin_clz(mask);
+            if (memcmp(pHaystack + i + nBit + 1, pNeedle + 1, nNeedle - 2) == 0)
             {
-                _nLength = strData._nLength;
-                _nSizeInBytes = _nLength + 1;
-
-                // new operator throws the std::bad_alloc excpetion in case of low memory
-                _pSeqOfChars = new char[_nSizeInBytes];
-                memcpy(_pSeqOfChars, strData._pSeqOfChars, _nLength);
-                _pSeqOfChars[_nLength] = '\0';
+                return i + nBit;
             }
+            mask &= ~(1u << nBit);
+        }
+    }
+    // starts left are [0, i)
+    _mm256_zeroupper();
+    return rfindSse2(pHaystack, i + nNeedle - 1, pNeedle, nNeedle);
+}
+
+// 64 characters per step while equal, then the 32 that differ are looked at
+__attribute__((target("avx2")))
+static size_t mismatchAvx2(const char* pLeft, const char* pRight, size_t nLength)
+{
+    size_t i = 0;
+    for (; i + 64 <= nLength; i += 64)
+    {
+        __m256i eq0 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pLeft + i)),
+                                        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pRight + i)));
+        __m256i eq1 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pLeft + i + 32)),
+                                        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pRight + i + 32)));
+        if (static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(eq0, eq1))) != 0xFFFFFFFFu)
+        {
+            break;
+        }
+    }
+    for (; i + 32 <= nLength; i += 32)
+    {
+        __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pLeft + i));
+        __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pRight + i));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(left, right)));
+        if (mask != 0xFFFFFFFFu)
+        {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + mismatchSse2(pLeft + i, pRight + i, nLength - i);
+}
+
+// any set size: the low nibble picks a row of the table (vpshufb), the high nibble a bit of it
+__attribute__((target("avx2")))
+static size_t findAnyOfAvx2(const char* pHaystack, size_t nHaystack, const stringTypeByteSet& setOfBytes)
+{
+    const __m256i lowHalf = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(setOfBytes.aLowHalf)));
+    const __m256i highHalf = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(setOfBytes.aHighHalf)));
+    const __m256i bitOf = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                           1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 32 <= nHaystack; i += 32)
+    {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pHaystack + i));
+        __m256i low = _mm256_and_si256(block, nibble);
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble);
+        // the top bit of each character picks the table of its half
+        __m256i rows = _mm256_blendv_epi8(_mm256_shuffle_epi8(lowHalf, low), _mm256_shuffle_epi8(highHalf, low), block);
+        __m256i hits = _mm256_and_si256(rows, _mm256_shuffle_epi8(bitOf, high));
+        unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hits, zero)));
+        if (mask)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper();
+    size_t nFound = findAnyOfSse2(pHaystack + i, nHaystack - i, setOfBytes);
+    return nFound == stringTypeNpos ? stringTypeNpos : i + nFound;
+}
+
+#endif // STRING_TYPE_X86
+
+// the best kernels the CPU runs, at most pLevel ("avx2", "sse2" or "scalar"; nullptr: no limit)
+static const stringTypeKernels* selectKernels(const char* pLevel)
+{
+    static const stringTypeKernels scalar = { "scalar", findCharScalar, rfindCharScalar, findScalar, rfindScalar, mismatchScalar, findAnyOfScalar };
+    const stringTypeKernels* pSelected = &scalar;
+
+#ifdef STRING_TYPE_X86
+    static const stringTypeKernels sse2 = { "sse2", findCharSse2, rfindCharSse2, findSse2, rfindSse2, mismatchSse2, findAnyOfSse2 };
+    static const stringTypeKernels avx2 = { "avx2", findCharAvx2, rfindCharAvx2, findAvx2, rfindAvx2, mismatchAvx2, findAnyOfAvx2 };
+
+    bool bAllowAvx2 = pLevel == nullptr || strcmp(pLevel, "avx2") == 0;
+    bool bAllowSse2 = bAllowAvx2 || strcmp(pLevel, "sse2") == 0;
+
+    __builtin_cpu_init();
+    if (bAllowAvx2 && __builtin_cpu_supports("avx2"))
+    {
+        pSelected = &avx2;
+    }
+    else if (bAllowSse2 && __builtin_cpu_supports("sse2"))
+    {
+        pSelected = &sse2;
+    }
+#endif
+
+    return pSelected;
+}
+
+// STRINGTYPE_SIMD can only lower the level, e.g. to compare kernels on the same box
+static std::atomic<const stringTypeKernels*>& selectedKernels()
+{
+    static std::atomic<const stringTypeKernels*> pSelected(selectKernels(getenv("STRINGTYPE_SIMD")));
+    return pSelected;
+}
+
+static const stringTypeKernels& kernels()
+{
+    return *selectedKernels().load(std::memory_order_relaxed);
+}
+
+size_t stringTypeFindChar(const char* pHaystack, size_t nHaystack, char cNeedle)
+{
+    return kernels().findChar(pHaystack, nHaystack, cNeedle);
+}
+
+size_t stringTypeRFindChar(const char* pHaystack, size_t nHaystack, char cNeedle)
+{
+    return kernels().rfindChar(pHaystack, nHaystack, cNeedle);
+}
+
+size_t stringTypeFind(const char* pHaystack, size_t nHaystack, const char* pNeedle, size_t nNeedle)
+{
+    if (nNeedle == 0)
+    {
+        return 0;
+    }
+    if (nNeedle > nHaystack)
+    {
+        return stringTypeNpos;
+    }
+    return kernels().find(pHaystack, nHaystack, pNeedle, nNeedle);
+}
+
+size_t stringTypeRFind(const char* pHaystack, size_t nHaystack, const char* pNeedle, size_t nNeedle)
+{
+    if (nNeedle == 0)
+    {
+        return nHaystack;
+    }
+    if (nNeedle > nHaystack)
+    {
+        return stringTypeNpos;
+    }
+    return kernels().rfind(pHaystack, nHaystack, pNeedle, nNeedle);
+}
+
+size_t stringTypeMismatch(const char* pLeft, const char* pRight, size_t nLength)
+{
+    // short keys: the dispatch would cost more than the compare
+    if (nLength < 16)
+    {
+        return mismatchScalar(pLeft, pRight, nLength);
+    }
+    return kernels().mismatch(pLeft, pRight, nLength);
+}
+
+size_t stringTypeFindAnyOf(const char* pHaystack, size_t nHaystack, const stringTypeByteSet& setOfBytes)
+{
+    if (setOfBytes.nBytes <= 1)
+    {
+        return setOfBytes.nBytes == 0 ? stringTypeNpos : kernels().findChar(pHaystack, nHaystack, setOfBytes.aBytes[0]);
+    }
+    return kernels().findAnyOf(pHaystack, nHaystack, setOfBytes);
+}
+
+const char* stringTypeSimdLevel()
+{
+    return kernels().pName;
+}
+
+const char* stringTypeSetSimdLevel(const char* pLevel)
+{
+    selectedKernels().store(selectKernels(pLevel), std::memory_order_relaxed);
+    return kernels().pName;
+}
+
+// wyhash (final version) mixing: 64x64->128 multiply, fold the halves
+static uint64_t hashMix(uint64_t a, uint64_t b)
+{
+    __uint128_t r = static_cast<__uint128_t>(a) * b;
+    return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+}
+
+static uint64_t hashRead8(const char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t hashRead4(const char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint64_t stringTypeHash(const char* pSeqOfChars, size_t nLength)
+{
+    static constexpr uint64_t s0 = 0xa0761d6478bd642full;
+    static constexpr uint64_t s1 = 0xe7037ed1a0b428dbull;
+    static constexpr uint64_t s2 = 0x8ebc6af09c88c6e3ull;
+    static constexpr uint64_t s3 = 0x589965cc75374cc3ull;
+
+    if (nLength == 0)
+    {
+        return 0;
+    }
+
+    const char* p = pSeqOfChars;
+    uint64_t seed = hashMix(s0, s1);
+    uint64_t a;
+    uint64_t b;
+    if (nLength <= 16)
+    {
+        if (nLength >= 4)
+        {
+            // two overlapping pairs of 4 bytes cover 4..16 characters
+            size_t nStep = (nLength >> 3) << 2;
+            a = (hashRead4(p) << 32) | hashRead4(p + nStep);
+            b = (hashRead4(p + nLength - 4) << 32) | hashRead4(p + nLength - 4 - nStep);
+        }
+        else
+        {
+            const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+            a = (uint64_t(u[0]) << 16) | (uint64_t(u[nLength >> 1]) << 8) | u[nLength - 1];
+            b = 0;
+        }
+    }
+    else
+    {
+        size_t i = nLength;
+        if (i > 48)
+        {
+            // three independent lanes keep the multipliers busy
+            uint64_t see1 = seed;
+            uint64_t see2 = seed;
+            do
+            {
+                seed = hashMix(hashRead8(p) ^ s1, hashRead8(p + 8) ^ seed);
+                see1 = hashMix(hashRead8(p + 16) ^ s2, hashRead8(p + 24) ^ see1);
+                see2 = hashMix(hashRead8(p + 32) ^ s3, hashRead8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16)
+        {
+            seed = hashMix(hashRead8(p) ^ s1, hashRead8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = hashRead8(p + i - 16);
+        b = hashRead8(p + i - 8);
+    }
+
+    a ^= s1;
+    b ^= seed;
+    __uint128_t r = static_cast<__uint128_t>(a) * b;
+    a = static_cast<uint64_t>(r);
+    b = static_cast<uint64_t>(r >> 64);
+    return hashMix(a ^ s0 ^ nLength, b ^ s1);
+}
+
+stringType stringType::mapFile(const char* pPath)
+{
+    int fd = ::open(pPath, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+    {
+        return stringType();
+    }
+    struct stat fileStat;
+    bool bStat = ::fstat(fd, &fileStat) == 0;
+    if(!bStat || fileStat.st_size <= 0)
+    {
+        int nError = bStat ? 0 : errno;
+        ::close(fd);
+        errno = nError;
+        return stringType();
+    }
+    size_t nLength = static_cast<size_t>(fileStat.st_size);
+
+    // one byte more than the file, anonymous (zeros) first: whatever the file size, the byte after
+    // its last character reads as the terminator (rest of its last page, or the anonymous page after)
+    void* pArea = ::mmap(nullptr, nLength + 1, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(pArea == MAP_FAILED || ::mmap(pArea, nLength, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        int nError = errno;
+        if(pArea != MAP_FAILED)
+        {
+            ::munmap(pArea, nLength + 1);
         }
-};
\ No newline at end of file
+        ::close(fd);
+        errno = nError;
+        return stringType();
+    }
+    ::close(fd);
+    return adopt(static_cast<char*>(pArea), nLength, [](char* pSeqOfChars, size_t nLength) { ::munmap(pSeqOfChars, nLength + 1); });
+}
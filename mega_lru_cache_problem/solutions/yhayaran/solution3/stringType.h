@@ -0,0 +1,1346 @@
+/*
+*   Description:            Class to match the basic features of std::string
+*                           Strings represents the sequence of characters.
+*   Features Supported:     1. String constuction/destruction.
+*                           2. length function to count number of characters.
+*                           3. append function to
+*                           4. + operator to join two strings.
+*                           5. find/rfind functions to find a character or a string (shorter) within
+*                              string, with SSE2/AVX2 kernels picked at runtime (stringType.cpp).
+*                           6. Short strings (up to 23 characters) live inside the object, no allocation.
+*                           7. reserve/shrink_to_fit, appends grow the capacity geometrically (amortized O(1)).
+*                           8. Move construction/assignment steal the buffer, + on temporaries appends in place.
+*                           9. a + b + c builds a lazy stringTypeConcat, materialized with one allocation.
+*                              Materialize it in the same statement: it points to its operands (no auto x = a + b).
+*                           10. stringTypeView: pointer + length, substr/find/compare without allocating;
+*                              stringType converts to it implicitly, ==, <, ... are defined on views.
+*                           11. share(): opt-in copy-on-write, copies share one reference counted buffer.
+*                           12. Construction with a std::pmr::memory_resource (e.g. a per request arena).
+*                           13. hash(), cached by long strings until they change; std::hash and stringTypeHasher.
+*                           14. ==, compare, <, <=> (C++20): lengths (and cached hashes) first, then memcmp.
+*                              commonPrefixLength: SIMD mismatch kernel (stringType.cpp), 32/64 characters per step.
+*                           15. adopt()/mapFile(): characters someone else allocated (an mmap'd file), no copy,
+*                              handed to a deleter by the last copy; release() gives a buffer back to the caller.
+*                           16. findAnyOf(stringTypeByteSet): first of a set of delimiters, SIMD byte set lookup;
+*                              stringTypeSplit.h splits into views with it, no allocation per field.
+*   Layout:                 3 words. Long strings: pointer, length, capacity. Short strings: characters
+*                           and, in the last byte, 23 - length (so 0, the terminator, when full).
+*                           The top bit of that last byte (top bit of the capacity) tells long from short,
+*                           the next ones mark a shared buffer (a reference count sits before its characters)
+*                           and a buffer from a memory resource (the resource pointer sits there).
+*                           Long buffers: [mode header] [cached hash] characters, terminator.
+*                           Adopted buffers can't have anything before them: the capacity bits hold the address
+*                           of a control block (references, cached hash, deleter), the capacity is the length.
+*/
+#ifndef STRING_TYPE_H
+#define STRING_TYPE_H
+
+#include <iostream>
+#include <exception>
+#include <cstring>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+#include <atomic>
+#include <new>
+#include <memory_resource>
+#include <functional>
+#if __has_include(<compare>)
+#include <compare>
+#endif
+
+// search kernels, defined in stringType.cpp: index of the first/last match or stringTypeNpos
+static constexpr size_t stringTypeNpos = static_cast<size_t>(-1);
+size_t stringTypeFindChar(const char* pHaystack, size_t nHaystack, char cNeedle);
+size_t stringTypeRFindChar(const char* pHaystack, size_t nHaystack, char cNeedle);
+size_t stringTypeFind(const char* pHaystack, size_t nHaystack, const char* pNeedle, size_t nNeedle);
+size_t stringTypeRFind(const char* pHaystack, size_t nHaystack, const char* pNeedle, size_t nNeedle);
+// index of the first character where pLeft and pRight differ, nLength if none
+size_t stringTypeMismatch(const char* pLeft, const char* pRight, size_t nLength);
+// 64-bit hash of the characters (wyhash), 0 for none
+uint64_t stringTypeHash(const char* pSeqOfChars, size_t nLength);
+// "avx2", "sse2" or "scalar", STRINGTYPE_SIMD=<level> in the environment forces a lower one
+const char* stringTypeSimdLevel();
+// lowers the kernels to pLevel like STRINGTYPE_SIMD (nullptr: the best there is), returns the level in effect.
+// For tests and benchmarks: set it before other threads search
+const char* stringTypeSetSimdLevel(const char* pLevel);
+
+struct stringTypeByteSet;
+// index of the first character that is in setOfBytes, stringTypeNpos if none
+size_t stringTypeFindAnyOf(const char* pHaystack, size_t nHaystack, const stringTypeByteSet& setOfBytes);
+
+/**
+*   Non-owning characters: pointer + length, not terminated. A stringType converts to it
+*   implicitly, substr() of either returns one, so parsing and key lookups don't allocate.
+*   Valid while the characters it points to are: don't keep it past a change of its stringType.
+*/
+class stringTypeView
+{
+    public:
+        static constexpr size_t npos = stringTypeNpos;
+
+        stringTypeView() : _pSeqOfChars(""), _nLength(0)
+        { }
+
+        stringTypeView(const char* pSeqOfChars)
+            : _pSeqOfChars(pSeqOfChars != nullptr ? pSeqOfChars : ""),
+              _nLength(pSeqOfChars != nullptr ? strlen(pSeqOfChars) : 0)
+        { }
+
+        stringTypeView(const char* pSeqOfChars, size_t nLength) : _pSeqOfChars(pSeqOfChars), _nLength(nLength)
+        { }
+
+        const char* data() const
+        {
+            return _pSeqOfChars;
+        }
+
+        size_t length() const
+        {
+            return _nLength;
+        }
+
+        bool empty() const
+        {
+            return _nLength == 0;
+        }
+
+        char operator[] (size_t nPos) const
+        {
+            return _pSeqOfChars[nPos];
+        }
+
+        // nCount characters from nPos, both clamped to the view (no exception like std::string_view)
+        stringTypeView substr(size_t nPos, size_t nCount = npos) const
+        {
+            if(nPos > _nLength)
+            {
+                nPos = _nLength;
+            }
+            if(nCount > _nLength - nPos)
+            {
+                nCount = _nLength - nPos;
+            }
+            return stringTypeView(_pSeqOfChars + nPos, nCount);
+        }
+
+        void remove_prefix(size_t nCount)
+        {
+            _pSeqOfChars += nCount;
+            _nLength -= nCount;
+        }
+
+        void remove_suffix(size_t nCount)
+        {
+            _nLength -= nCount;
+        }
+
+        // index of the first cNeedle at or after nPos, npos if none
+        size_t find(char cNeedle, size_t nPos = 0) const
+        {
+            if(nPos >= _nLength)
+            {
+                return npos;
+            }
+            size_t nFound = stringTypeFindChar(_pSeqOfChars + nPos, _nLength - nPos, cNeedle);
+            return nFound == npos ? npos : nPos + nFound;
+        }
+
+        size_t find(stringTypeView strNeedle, size_t nPos = 0) const
+        {
+            if(nPos > _nLength || strNeedle._nLength > _nLength - nPos)
+            {
+                return npos;
+            }
+            size_t nFound = stringTypeFind(_pSeqOfChars + nPos, _nLength - nPos, strNeedle._pSeqOfChars, strNeedle._nLength);
+            return nFound == npos ? npos : nPos + nFound;
+        }
+
+        // index of the last cNeedle at or before nPos, npos if none
+        size_t rfind(char cNeedle, size_t nPos = npos) const
+        {
+            if(_nLength == 0)
+            {
+                return npos;
+            }
+            size_t nEnd = nPos < _nLength ? nPos + 1 : _nLength;
+            return stringTypeRFindChar(_pSeqOfChars, nEnd, cNeedle);
+        }
+
+        size_t rfind(stringTypeView strNeedle, size_t nPos = npos) const
+        {
+            if(strNeedle._nLength > _nLength)
+            {
+                return npos;
+            }
+            // a match may start at nPos at most, so it ends before nPos + length of the needle
+            size_t nEnd = nPos < _nLength - strNeedle._nLength ? nPos + strNeedle._nLength : _nLength;
+            return stringTypeRFind(_pSeqOfChars, nEnd, strNeedle._pSeqOfChars, strNeedle._nLength);
+        }
+
+        bool starts_with(stringTypeView strPrefix) const
+        {
+            return strPrefix._nLength <= _nLength && memcmp(_pSeqOfChars, strPrefix._pSeqOfChars, strPrefix._nLength) == 0;
+        }
+
+        bool ends_with(stringTypeView strSuffix) const
+        {
+            return strSuffix._nLength <= _nLength
+                && memcmp(_pSeqOfChars + _nLength - strSuffix._nLength, strSuffix._pSeqOfChars, strSuffix._nLength) == 0;
+        }
+
+        // characters at the start shared with strOther (URL-like keys: the common path)
+        size_t commonPrefixLength(stringTypeView strOther) const
+        {
+            size_t nCommon = _nLength < strOther._nLength ? _nLength : strOther._nLength;
+            return stringTypeMismatch(_pSeqOfChars, strOther._pSeqOfChars, nCommon);
+        }
+
+        // same characters: lengths first, the same pointer, then memcmp (vectorized and dispatched by libc)
+        bool equals(stringTypeView strOther) const
+        {
+            return _nLength == strOther._nLength
+                && (_pSeqOfChars == strOther._pSeqOfChars || memcmp(_pSeqOfChars, strOther._pSeqOfChars, _nLength) == 0);
+        }
+
+        // <0, 0, >0 like strcmp, bytes compared unsigned, a prefix sorts first
+        int compare(stringTypeView strOther) const
+        {
+            size_t nCommon = _nLength < strOther._nLength ? _nLength : strOther._nLength;
+            int nResult = nCommon > 0 && _pSeqOfChars != strOther._pSeqOfChars ? memcmp(_pSeqOfChars, strOther._pSeqOfChars, nCommon) : 0;
+            if(nResult != 0)
+            {
+                return nResult < 0 ? -1 : 1;
+            }
+            return _nLength < strOther._nLength ? -1 : (_nLength > strOther._nLength ? 1 : 0);
+        }
+
+        // index of the first character of setOfBytes at or after nPos, npos if none (defined below)
+        size_t findAnyOf(const stringTypeByteSet& setOfBytes, size_t nPos = 0) const;
+
+        uint64_t hash() const
+        {
+            return stringTypeHash(_pSeqOfChars, _nLength);
+        }
+
+        // operand of a + chain
+        char* copyTo(char* pDest) const
+        {
+            if(_nLength > 0)
+            {
+                memcpy(pDest, _pSeqOfChars, _nLength);
+            }
+            return pDest + _nLength;
+        }
+
+    protected:
+        const char* _pSeqOfChars;
+        size_t _nLength;
+};
+
+/**
+*   A set of bytes (e.g. the delimiters of a record) and the lookup tables of stringTypeFindAnyOf,
+*   built once. Byte c = hi:lo (nibbles) is in the set when bit (hi & 7) of aLowHalf[lo] (c < 128)
+*   or aHighHalf[lo] (c >= 128) is set: the AVX2 kernel looks up 32 characters at once with vpshufb.
+*   The first 8 bytes are also listed, the SSE2 kernel compares with each of them.
+*/
+struct stringTypeByteSet
+{
+    explicit stringTypeByteSet(stringTypeView strBytes)
+    {
+        for (size_t i = 0; i < strBytes.length(); ++i)
+        {
+            add(strBytes[i]);
+        }
+    }
+
+    void add(char cByte)
+    {
+        unsigned char c = static_cast<unsigned char>(cByte);
+        if(contains(cByte))
+        {
+            return;
+        }
+        aBitmap[c >> 6] |= uint64_t(1) << (c & 63);
+        (c < 128 ? aLowHalf : aHighHalf)[c & 15] |= static_cast<uint8_t>(1u << ((c >> 4) & 7));
+        if(nBytes < sizeof(aBytes))
+        {
+            aBytes[nBytes] = cByte;
+        }
+        ++nBytes;
+    }
+
+    bool contains(char cByte) const
+    {
+        unsigned char c = static_cast<unsigned char>(cByte);
+        return (aBitmap[c >> 6] >> (c & 63)) & 1;
+    }
+
+    uint64_t aBitmap[4] = {};
+    uint8_t aLowHalf[16] = {};
+    uint8_t aHighHalf[16] = {};
+    char aBytes[8] = {};
+    size_t nBytes = 0;
+};
+
+inline size_t stringTypeView::findAnyOf(const stringTypeByteSet& setOfBytes, size_t nPos) const
+{
+    if(nPos >= _nLength)
+    {
+        return npos;
+    }
+    size_t nFound = stringTypeFindAnyOf(_pSeqOfChars + nPos, _nLength - nPos, setOfBytes);
+    return nFound == npos ? npos : nPos + nFound;
+}
+
+// stringType and const char* convert to views, so these compare any mix of the three
+inline bool operator== (stringTypeView strLeft, stringTypeView strRight)
+{
+    return strLeft.equals(strRight);
+}
+
+inline bool operator!= (stringTypeView strLeft, stringTypeView strRight)
+{
+    return !(strLeft == strRight);
+}
+
+inline bool operator< (stringTypeView strLeft, stringTypeView strRight)
+{
+    return strLeft.compare(strRight) < 0;
+}
+
+inline bool operator> (stringTypeView strLeft, stringTypeView strRight)
+{
+    return strLeft.compare(strRight) > 0;
+}
+
+inline bool operator<= (stringTypeView strLeft, stringTypeView strRight)
+{
+    return strLeft.compare(strRight) <= 0;
+}
+
+inline bool operator>= (stringTypeView strLeft, stringTypeView strRight)
+{
+    return strLeft.compare(strRight) >= 0;
+}
+
+#if defined(__cpp_impl_three_way_comparison) && defined(__cpp_lib_three_way_comparison)
+inline std::strong_ordering operator<=> (stringTypeView strLeft, stringTypeView strRight)
+{
+    return strLeft.compare(strRight) <=> 0;
+}
+#endif
+
+inline std::ostream& operator<< (std::ostream& os, stringTypeView strData)
+{
+    return os.write(strData.data(), static_cast<std::streamsize>(strData.length()));
+}
+
+template <typename L, typename R>
+class stringTypeConcat;
+
+// frees adopted characters: deleter(pSeqOfChars, nLength)
+typedef std::function<void(char*, size_t)> stringTypeDeleter;
+
+// what stringType::release() hands back: the caller owns the characters (terminated), until deleter is called
+struct stringTypeReleased
+{
+    char* pSeqOfChars;
+    size_t nLength;
+    stringTypeDeleter deleter;
+};
+
+#if defined(__BYTE_ORDER__)
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "stringType packs its flag in the last byte of the capacity");
+#endif
+
+class stringType
+{
+    protected:
+        // stringType when all of S are stringType, i.e. forwarding references bound to temporaries
+        template <typename... S>
+        using _Temporary = typename std::enable_if<(std::is_same<S, stringType>::value && ...), stringType>::type;
+
+    public:
+        stringType()
+        {
+            _setShortLength(0);
+        }
+
+        stringType(const char* pSeqOfChars)
+        {
+            _setShortLength(0);
+            _copyFromCharPointer(pSeqOfChars);
+        }
+
+        // stringType(nullptr) is empty, as for a null const char*, not a string of no resource
+        stringType(std::nullptr_t)
+        {
+            _setShortLength(0);
+        }
+
+        stringType(const char* pSeqOfChars, size_t nLength)
+        {
+            _setShortLength(0);
+            memcpy(_reserveEmpty(nLength), pSeqOfChars, nLength);
+        }
+
+        // explicit: copying out of a view allocates, keep it visible
+        explicit stringType(stringTypeView strView) : stringType(strView.data(), strView.length())
+        { }
+
+        /**
+        *   Strings whose buffers come from pResource, e.g. a std::pmr::monotonic_buffer_resource per request:
+        *   construction is a pointer bump, destruction frees nothing, the arena releases all at once.
+        *   They stay long (the resource pointer is in front of the characters) and keep their resource
+        *   when they grow or are cleared. Like std::pmr strings, copies of them use new[] again and a
+        *   move assignment between different resources copies, so nothing outlives its arena by accident.
+        */
+        explicit stringType(std::pmr::memory_resource* pResource, size_t nCapacity = _nMaxShortLength)
+        {
+            _setShortLength(0);
+            _initResource(pResource, nCapacity);
+        }
+
+        stringType(stringTypeView strView, std::pmr::memory_resource* pResource)
+        {
+            _setShortLength(0);
+            _initResource(pResource, strView.length());
+            _append(strView.data(), strView.length());
+        }
+
+        // a shared string is not copied, only its reference count goes up
+        stringType(const stringType& stringObj)
+        {
+            _setShortLength(0);
+            _copyFromStringType(stringObj);
+        }
+
+        stringType(stringType&& stringObj) noexcept : _rep(stringObj._rep)
+        {
+            stringObj._setShortLength(0);
+        }
+
+        // reuses our buffer when the characters fit
+        stringType& operator= (const stringType& stringObj)
+        {
+            if(this != &stringObj)
+            {
+                if(stringObj._isReadOnly() && !_hasResource())
+                {
+                    _reset();
+                    _copyFromStringType(stringObj);
+                }
+                else
+                {
+                    _assign(stringObj.c_str(), stringObj.length());
+                }
+            }
+            return *this;
+        }
+
+        // steals the buffer when both use the same resource (new[] for most), copies otherwise
+        stringType& operator= (stringType&& stringObj)
+        {
+            if(this != &stringObj)
+            {
+                if(resource() == stringObj.resource())
+                {
+                    _reset();
+                    _rep = stringObj._rep;
+                    stringObj._setShortLength(0);
+                }
+                else
+                {
+                    _assign(stringObj.c_str(), stringObj.length());
+                }
+            }
+            return *this;
+        }
+
+        stringType& operator= (const char* pSeqOfChars)
+        {
+            _assign(pSeqOfChars, pSeqOfChars != nullptr ? strlen(pSeqOfChars) : 0);
+            return *this;
+        }
+
+        // the view may point into this string (s = s.substr(...))
+        stringType& operator= (stringTypeView strView)
+        {
+            _assign(strView.data(), strView.length());
+            return *this;
+        }
+
+        // materializes a + chain: the total length is known, so one allocation and each piece copied once
+        template <typename L, typename R>
+        stringType(const stringTypeConcat<L, R>& strExpr)
+        {
+            _setShortLength(0);
+            strExpr.copyTo(_reserveEmpty(strExpr.length()));
+        }
+
+        // temporaries are extended in place and moved out, no new buffer unless they are full.
+        // Templates so only a real stringType temporary binds (no const char* -> stringType),
+        // everything else converts to stringTypeView and takes the lazy operator+ below the class.
+        template <typename S>
+        friend _Temporary<S> operator+ (S&& strLeft, stringTypeView strRight)
+        {
+            strLeft.append(strRight);
+            return std::move(strLeft);
+        }
+
+        template <typename S, typename L, typename R>
+        friend _Temporary<S> operator+ (S&& strLeft, const stringTypeConcat<L, R>& strRight)
+        {
+            strLeft.append(strRight);
+            return std::move(strLeft);
+        }
+
+        template <typename S>
+        friend _Temporary<S> operator+ (stringTypeView strLeft, S&& strRight)
+        {
+            strRight._prepend(strLeft.data(), strLeft.length());
+            return std::move(strRight);
+        }
+
+        template <typename S1, typename S2>
+        friend _Temporary<S1, S2> operator+ (S1&& strLeft, S2&& strRight)
+        {
+            strLeft.append(strRight);
+            return std::move(strLeft);
+        }
+
+        ~stringType()
+        {
+            _reset();
+        }
+
+        void append(const char* pSeqOfChars)
+        {
+            if(pSeqOfChars != nullptr)
+            {
+                _append(pSeqOfChars, strlen(pSeqOfChars));
+            }
+        }
+
+        void append(const stringType& strData)
+        {
+            _append(strData.c_str(), strData.length());
+        }
+
+        void append(stringTypeView strView)
+        {
+            _append(strView.data(), strView.length());
+        }
+
+        template <typename L, typename R>
+        void append(const stringTypeConcat<L, R>& strExpr)
+        {
+            _appendWith(strExpr.length(), [&strExpr](char* pDest) { strExpr.copyTo(pDest); });
+        }
+
+        // stringTypeHash of the characters, long strings keep it next to them until they change
+        uint64_t hash() const
+        {
+            if(_isShort())
+            {
+                return stringTypeHash(_rep._short, length());
+            }
+            uint64_t nHash = _hashSlot()->load(std::memory_order_relaxed);
+            if(nHash == 0)
+            {
+                // racing readers of a shared buffer store the same value
+                nHash = stringTypeHash(_rep._long.pSeqOfChars, _rep._long.nLength);
+                _hashSlot()->store(nHash, std::memory_order_relaxed);
+            }
+            return nHash;
+        }
+
+        // lengths first, then the cached hashes when both long strings have one, then the characters
+        friend bool operator== (const stringType& strLeft, const stringType& strRight)
+        {
+            if(strLeft.length() != strRight.length())
+            {
+                return false;
+            }
+            if(!strLeft._isShort() && !strRight._isShort())
+            {
+                uint64_t nLeft = strLeft._hashSlot()->load(std::memory_order_relaxed);
+                uint64_t nRight = strRight._hashSlot()->load(std::memory_order_relaxed);
+                if(nLeft != 0 && nRight != 0 && nLeft != nRight)
+                {
+                    return false;
+                }
+            }
+            return strLeft.view().equals(strRight.view());
+        }
+
+        friend bool operator!= (const stringType& strLeft, const stringType& strRight)
+        {
+            return !(strLeft == strRight);
+        }
+
+        // exact matches for views and literals, so s == "..." does not build a stringType to compare with
+        friend bool operator== (const stringType& strLeft, stringTypeView strRight)
+        {
+            return strLeft.view().equals(strRight);
+        }
+
+        friend bool operator== (stringTypeView strLeft, const stringType& strRight)
+        {
+            return strLeft.equals(strRight.view());
+        }
+
+        friend bool operator== (const stringType& strLeft, const char* pRight)
+        {
+            return strLeft.view().equals(stringTypeView(pRight));
+        }
+
+        friend bool operator== (const char* pLeft, const stringType& strRight)
+        {
+            return stringTypeView(pLeft).equals(strRight.view());
+        }
+
+        friend bool operator!= (const stringType& strLeft, stringTypeView strRight)
+        {
+            return !(strLeft == strRight);
+        }
+
+        friend bool operator!= (stringTypeView strLeft, const stringType& strRight)
+        {
+            return !(strLeft == strRight);
+        }
+
+        friend bool operator!= (const stringType& strLeft, const char* pRight)
+        {
+            return !(strLeft == pRight);
+        }
+
+        friend bool operator!= (const char* pLeft, const stringType& strRight)
+        {
+            return !(pLeft == strRight);
+        }
+
+        // strings of a resource keep their buffer, the others give it back
+        void clear()
+        {
+            if(_hasResource())
+            {
+                _setLength(0);
+                return;
+            }
+            _reset();
+        }
+
+        // where our buffers come from, nullptr for new[]
+        std::pmr::memory_resource* resource() const
+        {
+            return _hasResource() ? _resourceHeader()->pResource : nullptr;
+        }
+
+        // bytes used by the characters and the terminator, 0 when empty
+        size_t size() const
+        {
+            size_t nLength = length();
+            return nLength > 0 ? nLength + 1 : 0;
+        }
+
+        size_t length() const
+        {
+            return _isShort() ? _nMaxShortLength - _lastByte() : _rep._long.nLength;
+        }
+
+        const char* c_str() const
+        {
+            return _isShort() ? _rep._short : _rep._long.pSeqOfChars;
+        }
+
+        static constexpr size_t npos = stringTypeNpos;
+
+        operator stringTypeView() const
+        {
+            return view();
+        }
+
+        stringTypeView view() const
+        {
+            return stringTypeView(c_str(), length());
+        }
+
+        // view of nCount characters from nPos (clamped), no copy: valid until this string changes
+        stringTypeView substr(size_t nPos, size_t nCount = npos) const
+        {
+            return view().substr(nPos, nCount);
+        }
+
+        // index of the first cNeedle at or after nPos, npos if none
+        size_t find(char cNeedle, size_t nPos = 0) const
+        {
+            return view().find(cNeedle, nPos);
+        }
+
+        size_t find(stringTypeView strNeedle, size_t nPos = 0) const
+        {
+            return view().find(strNeedle, nPos);
+        }
+
+        // index of the last cNeedle at or before nPos, npos if none
+        size_t rfind(char cNeedle, size_t nPos = npos) const
+        {
+            return view().rfind(cNeedle, nPos);
+        }
+
+        size_t rfind(stringTypeView strNeedle, size_t nPos = npos) const
+        {
+            return view().rfind(strNeedle, nPos);
+        }
+
+        // characters that fit without reallocating
+        size_t capacity() const
+        {
+            return _capacity();
+        }
+
+        void reserve(size_t nCapacity)
+        {
+            if(nCapacity > _capacity())
+            {
+                _reallocate(nCapacity);
+            }
+        }
+
+        /**
+        *   Opt-in copy-on-write: moves the characters (once) to an immutable reference counted buffer,
+        *   then copies of this string, and copies of the copies, share it for an atomic increment.
+        *   Any change to one of them copies the characters out first (capacity() is length() until then).
+        *   Short strings stay inline, copying them is already cheap. A string of a resource moves to new[].
+        */
+        void share()
+        {
+            size_t nLength = length();
+            if(_isShort() || _isReadOnly())
+            {
+                return;
+            }
+            char* pShared = _allocateShared(nLength);
+            memcpy(pShared, c_str(), nLength + 1);
+            _reset();
+            _setLong(pShared, nLength, nLength | _nSharedFlag);
+        }
+
+        // straight into a shared buffer, one allocation
+        static stringType shared(stringTypeView strView)
+        {
+            size_t nLength = strView.length();
+            if(nLength <= _nMaxShortLength)
+            {
+                return stringType(strView);
+            }
+            stringType strShared;
+            char* pShared = _allocateShared(nLength);
+            memcpy(pShared, strView.data(), nLength);
+            pShared[nLength] = '\0';
+            strShared._setLong(pShared, nLength, nLength | _nSharedFlag);
+            return strShared;
+        }
+
+        bool isShared() const
+        {
+            return _isShared();
+        }
+
+        // strings sharing our characters, this one included (1 when not shared)
+        size_t useCount() const
+        {
+            if(_isExternal())
+            {
+                return _externalBlock()->nRefs.load(std::memory_order_relaxed);
+            }
+            return _isShared() ? _sharedHeader()->nRefs.load(std::memory_order_relaxed) : 1;
+        }
+
+        /**
+        *   Takes pSeqOfChars[0, nLength) as it is, no copy: deleter(pSeqOfChars, nLength) runs when the last
+        *   copy of the string goes (copies share it like share()d strings). pSeqOfChars[nLength] must be
+        *   readable and '\0', for c_str(). The characters are never written: changes copy them out first.
+        *   An empty deleter frees nothing (characters that outlive every string, e.g. static data).
+        *   One small allocation for the control block (deleter, references, cached hash).
+        */
+        static stringType adopt(char* pSeqOfChars, size_t nLength, stringTypeDeleter deleter)
+        {
+            stringType strAdopted;
+            _ExternalBlock* pBlock = new _ExternalBlock{{1}, {0}, std::move(deleter)};
+            if((reinterpret_cast<uintptr_t>(pBlock) & ~_nCapacityMask) != 0 || nLength > _nCapacityMask)
+            {
+                // no room for the address in the capacity bits (some 32-bit address spaces): a plain copy
+                memcpy(strAdopted._reserveEmpty(nLength), pSeqOfChars, nLength);
+                if(pBlock->deleter)
+                {
+                    pBlock->deleter(pSeqOfChars, nLength);
+                }
+                delete pBlock;
+                return strAdopted;
+            }
+            strAdopted._setLong(pSeqOfChars, nLength, reinterpret_cast<uintptr_t>(pBlock) | _nExternalFlag);
+            return strAdopted;
+        }
+
+        /**
+        *   The file's contents, mapped read only (mmap, MAP_PRIVATE) and adopted: pages are read in when
+        *   touched, nothing is copied, munmap when the last copy goes. Empty on errors (errno tells which)
+        *   and for empty files. Defined in stringType.cpp.
+        */
+        static stringType mapFile(const char* pPath);
+
+        bool isAdopted() const
+        {
+            return _isExternal();
+        }
+
+        /**
+        *   Hands the characters to the caller and leaves this string empty. An adopted buffer no other
+        *   string uses comes back as it went in, with its deleter; other long buffers we own alone are
+        *   given without copying (the deleter frees them the way we would). Short strings and buffers
+        *   still shared by other strings are copied to new[] (the deleter is a delete[]).
+        */
+        stringTypeReleased release()
+        {
+            size_t nLength = length();
+            if(_isExternal() && useCount() == 1)
+            {
+                _ExternalBlock* pBlock = _externalBlock();
+                stringTypeReleased released{_rep._long.pSeqOfChars, nLength, std::move(pBlock->deleter)};
+                delete pBlock;
+                _setShortLength(0);
+                return released;
+            }
+            if(!_isShort() && useCount() == 1)
+            {
+                stringType* pOwner = new stringType(std::move(*this));
+                return stringTypeReleased{pOwner->_rep._long.pSeqOfChars, nLength, [pOwner](char*, size_t) { delete pOwner; }};
+            }
+            char* pCopy = new char[nLength + 1];
+            memcpy(pCopy, c_str(), nLength + 1);
+            _reset();
+            return stringTypeReleased{pCopy, nLength, [](char* pSeqOfChars, size_t) { delete[] pSeqOfChars; }};
+        }
+
+        // gives back the unused capacity, back inside the object if it fits
+        void shrink_to_fit()
+        {
+            if(!_isShort() && _capacity() > length() && !_isReadOnly())
+            {
+                _reallocate(length());
+            }
+        }
+
+    protected:
+        struct _LongRep
+        {
+            char* pSeqOfChars;
+            size_t nLength;
+            size_t nCapacity;   // characters that fit without the terminator, top byte holds the flag
+        };
+
+        union _Rep
+        {
+            _LongRep _long;
+            char _short[sizeof(_LongRep)];
+        } _rep;
+
+        static constexpr size_t _nMaxShortLength = sizeof(_LongRep) - 1;
+        static constexpr size_t _nLongFlag = size_t(0x80) << (8 * (sizeof(size_t) - 1));
+        static constexpr size_t _nSharedFlag = size_t(0x40) << (8 * (sizeof(size_t) - 1));
+        static constexpr size_t _nResourceFlag = size_t(0x20) << (8 * (sizeof(size_t) - 1));
+        static constexpr size_t _nExternalFlag = size_t(0x10) << (8 * (sizeof(size_t) - 1));
+        static constexpr size_t _nCapacityMask = (size_t(1) << (8 * (sizeof(size_t) - 1))) - 1;
+
+        unsigned char _lastByte() const
+        {
+            return static_cast<unsigned char>(_rep._short[_nMaxShortLength]);
+        }
+
+        bool _isShort() const
+        {
+            return (_lastByte() & 0x80) == 0;
+        }
+
+        bool _isShared() const
+        {
+            return !_isShort() && (_rep._long.nCapacity & _nSharedFlag) != 0;
+        }
+
+        bool _isExternal() const
+        {
+            return !_isShort() && (_rep._long.nCapacity & _nExternalFlag) != 0;
+        }
+
+        // characters other strings may be reading: copied out before any change
+        bool _isReadOnly() const
+        {
+            return _isShared() || _isExternal();
+        }
+
+        // before the characters of a shared buffer
+        struct _SharedHeader
+        {
+            std::atomic<size_t> nRefs;
+        };
+
+        // every long buffer has the hash of its characters right before them, 0 until asked for
+        typedef std::atomic<uint64_t> _HashSlot;
+
+        // owner of adopted characters, its address is in the capacity bits
+        struct _ExternalBlock
+        {
+            std::atomic<size_t> nRefs;
+            _HashSlot nHash;
+            stringTypeDeleter deleter;
+        };
+
+        _ExternalBlock* _externalBlock() const
+        {
+            return reinterpret_cast<_ExternalBlock*>(_rep._long.nCapacity & _nCapacityMask);
+        }
+
+        _HashSlot* _hashSlot() const
+        {
+            if(_isExternal())
+            {
+                return &_externalBlock()->nHash;
+            }
+            return reinterpret_cast<_HashSlot*>(_rep._long.pSeqOfChars - sizeof(_HashSlot));
+        }
+
+        // puts an empty hash slot after nHeader bytes, returns where the characters go
+        static char* _initBlock(char* pBlock, size_t nHeader)
+        {
+            new (pBlock + nHeader) _HashSlot(0);
+            return pBlock + nHeader + sizeof(_HashSlot);
+        }
+
+        // blocks of a mode start with its header, then the hash slot
+        _SharedHeader* _sharedHeader() const
+        {
+            return reinterpret_cast<_SharedHeader*>(_rep._long.pSeqOfChars - sizeof(_HashSlot) - sizeof(_SharedHeader));
+        }
+
+        // characters of a new shared buffer (one reference), room for nLength and the terminator
+        static char* _allocateShared(size_t nLength)
+        {
+            char* pBlock = new char[sizeof(_SharedHeader) + sizeof(_HashSlot) + nLength + 1];
+            new (pBlock) _SharedHeader{{1}};
+            return _initBlock(pBlock, sizeof(_SharedHeader));
+        }
+
+        bool _hasResource() const
+        {
+            return !_isShort() && (_rep._long.nCapacity & _nResourceFlag) != 0;
+        }
+
+        // before the characters of a buffer from a memory resource
+        struct _ResourceHeader
+        {
+            std::pmr::memory_resource* pResource;
+        };
+
+        _ResourceHeader* _resourceHeader() const
+        {
+            return reinterpret_cast<_ResourceHeader*>(_rep._long.pSeqOfChars - sizeof(_HashSlot) - sizeof(_ResourceHeader));
+        }
+
+        static size_t _resourceBlockSize(size_t nCapacity)
+        {
+            return sizeof(_ResourceHeader) + sizeof(_HashSlot) + nCapacity + 1;
+        }
+
+        // characters for nCapacity and the terminator, from pResource or new[] when there is none
+        static char* _allocateLong(size_t nCapacity, std::pmr::memory_resource* pResource)
+        {
+            if(pResource == nullptr)
+            {
+                // new operator throws the std::bad_alloc excpetion in case of low memory
+                return _initBlock(new char[sizeof(_HashSlot) + nCapacity + 1], 0);
+            }
+            char* pBlock = static_cast<char*>(pResource->allocate(_resourceBlockSize(nCapacity), alignof(_ResourceHeader)));
+            new (pBlock) _ResourceHeader{pResource};
+            return _initBlock(pBlock, sizeof(_ResourceHeader));
+        }
+
+        void _initResource(std::pmr::memory_resource* pResource, size_t nCapacity)
+        {
+            if(pResource == nullptr)
+            {
+                reserve(nCapacity);
+                return;
+            }
+            char* pSeqOfChars = _allocateLong(nCapacity, pResource);
+            pSeqOfChars[0] = '\0';
+            _setLong(pSeqOfChars, 0, nCapacity | _nResourceFlag);
+        }
+
+        // swaps our long buffer for pSeqOfChars (from _allocateLong), same resource
+        void _replaceLong(char* pSeqOfChars, size_t nLength, size_t nCapacity)
+        {
+            size_t nFlags = _hasResource() ? _nResourceFlag : 0;
+            if(!_isShort())
+            {
+                _freeLong();
+            }
+            _setLong(pSeqOfChars, nLength, nCapacity | nFlags);
+        }
+
+        // back to an empty short string, whatever the mode
+        void _reset()
+        {
+            if(!_isShort())
+            {
+                _freeLong();
+            }
+            _setShortLength(0);
+        }
+
+        // drops our long buffer: the last reference of a shared or adopted one frees it
+        void _freeLong()
+        {
+            if(_isExternal())
+            {
+                _ExternalBlock* pBlock = _externalBlock();
+                if(pBlock->nRefs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    if(pBlock->deleter)
+                    {
+                        pBlock->deleter(_rep._long.pSeqOfChars, _rep._long.nLength);
+                    }
+                    delete pBlock;
+                }
+                return;
+            }
+            if(_hasResource())
+            {
+                _ResourceHeader* pHeader = _resourceHeader();
+                pHeader->pResource->deallocate(pHeader, _resourceBlockSize(_capacity()), alignof(_ResourceHeader));
+                return;
+            }
+            if(!_isShared())
+            {
+                delete[] (_rep._long.pSeqOfChars - sizeof(_HashSlot));
+                return;
+            }
+            _SharedHeader* pHeader = _sharedHeader();
+            if(pHeader->nRefs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                pHeader->~_SharedHeader();
+                delete[] reinterpret_cast<char*>(pHeader);
+            }
+        }
+
+        // for writes that fit the capacity: never a shared or adopted buffer, their capacity is their length
+        char* _data()
+        {
+            return _isShort() ? _rep._short : _rep._long.pSeqOfChars;
+        }
+
+        size_t _capacity() const
+        {
+            if(_isExternal())
+            {
+                return _rep._long.nLength;
+            }
+            return _isShort() ? _nMaxShortLength : (_rep._long.nCapacity & _nCapacityMask);
+        }
+
+        void _setShortLength(size_t nLength)
+        {
+            _rep._short[nLength] = '\0';
+            _rep._short[_nMaxShortLength] = static_cast<char>(_nMaxShortLength - nLength);
+        }
+
+        void _setLong(char* pSeqOfChars, size_t nLength, size_t nCapacity)
+        {
+            _rep._long.pSeqOfChars = pSeqOfChars;
+            _rep._long.nLength = nLength;
+            _rep._long.nCapacity = nCapacity | _nLongFlag;
+        }
+
+        void _setLength(size_t nLength)
+        {
+            if(_isShort())
+            {
+                _setShortLength(nLength);
+            }
+            else
+            {
+                _rep._long.pSeqOfChars[nLength] = '\0';
+                _rep._long.nLength = nLength;
+                _hashSlot()->store(0, std::memory_order_relaxed);
+            }
+        }
+
+        // moves the characters to a buffer of nCapacity (>= length), inline if it fits (not for a resource)
+        void _reallocate(size_t nCapacity)
+        {
+            size_t nLength = length();
+            if(nCapacity <= _nMaxShortLength && !_hasResource())
+            {
+                if(!_isShort())
+                {
+                    stringType strOld(std::move(*this));
+                    memcpy(_rep._short, strOld.c_str(), nLength);
+                    _setShortLength(nLength);
+                }
+                return;
+            }
+
+            char* pSeqOfChars = _allocateLong(nCapacity, resource());
+            memcpy(pSeqOfChars, c_str(), nLength + 1);
+            _replaceLong(pSeqOfChars, nLength, nCapacity);
+        }
+
+        // make room for nLength characters, only called on an empty (short) string
+        char* _reserveEmpty(size_t nLength)
+        {
+            if(nLength <= _nMaxShortLength)
+            {
+                _setShortLength(nLength);
+                return _rep._short;
+            }
+
+            char* pSeqOfChars = _allocateLong(nLength, nullptr);
+            pSeqOfChars[nLength] = '\0';
+            _setLong(pSeqOfChars, nLength, nLength);
+            return pSeqOfChars;
+        }
+
+        void _append(const char* pSeqOfChars, size_t nLenOfNewString)
+        {
+            _appendWith(nLenOfNewString, [pSeqOfChars, nLenOfNewString](char* pDest) { memcpy(pDest, pSeqOfChars, nLenOfNewString); });
+        }
+
+        // writer fills nLenOfNewString characters at the end, it may read our own characters
+        template <typename Writer>
+        void _appendWith(size_t nLenOfNewString, const Writer& writer)
+        {
+            if(nLenOfNewString == 0)
+            {
+                return;
+            }
+
+            size_t nLength = length();
+            size_t nNewLength = nLength + nLenOfNewString;
+
+            if(nNewLength <= _capacity())
+            {
+                // in place, the writer never reads past nLength
+                writer(_data() + nLength);
+                _setLength(nNewLength);
+                return;
+            }
+
+            // geometric growth keeps repeated appends amortized O(1)
+            size_t nNewCapacity = 2 * _capacity();
+            if(nNewCapacity < nNewLength)
+            {
+                nNewCapacity = nNewLength;
+            }
+
+            char* pBiggerString = _allocateLong(nNewCapacity, resource());
+            memcpy(pBiggerString, c_str(), nLength);
+            writer(pBiggerString + nLength);
+            pBiggerString[nNewLength] = '\0';
+
+            // the writer may read the old buffer so it goes last
+            _replaceLong(pBiggerString, nNewLength, nNewCapacity);
+        }
+
+        void _prepend(const char* pSeqOfChars, size_t nLenOfNewString)
+        {
+            if(nLenOfNewString == 0)
+            {
+                return;
+            }
+
+            size_t nLength = length();
+            size_t nNewLength = nLength + nLenOfNewString;
+            char* pData = _data();
+            bool bAliased = pSeqOfChars >= pData && pSeqOfChars <= pData + nLength;
+
+            if(nNewLength <= _capacity() && !bAliased)
+            {
+                memmove(pData + nLenOfNewString, pData, nLength);
+                memcpy(pData, pSeqOfChars, nLenOfNewString);
+                _setLength(nNewLength);
+                return;
+            }
+
+            size_t nNewCapacity = 2 * _capacity();
+            if(nNewCapacity < nNewLength)
+            {
+                nNewCapacity = nNewLength;
+            }
+
+            char* pBiggerString = _allocateLong(nNewCapacity, resource());
+            memcpy(pBiggerString, pSeqOfChars, nLenOfNewString);
+            memcpy(pBiggerString + nLenOfNewString, pData, nLength);
+            pBiggerString[nNewLength] = '\0';
+
+            _replaceLong(pBiggerString, nNewLength, nNewCapacity);
+        }
+
+        void _assign(const char* pSeqOfChars, size_t nLength)
+        {
+            if(_isReadOnly())
+            {
+                // the characters may be our own, copy them before letting go of the buffer
+                stringType strCopy(pSeqOfChars, nLength);
+                *this = std::move(strCopy);
+                return;
+            }
+
+            if(nLength <= _capacity())
+            {
+                // memmove, pSeqOfChars may point into our own characters
+                memmove(_data(), pSeqOfChars, nLength);
+                _setLength(nLength);
+                return;
+            }
+
+            char* pSeqOfCharsCopy = _allocateLong(nLength, resource());
+            memcpy(pSeqOfCharsCopy, pSeqOfChars, nLength);
+            pSeqOfCharsCopy[nLength] = '\0';
+
+            _replaceLong(pSeqOfCharsCopy, nLength, nLength);
+        }
+
+        void _copyFromCharPointer(const char* pSeqOfChars)
+        {
+            if (pSeqOfChars != nullptr)
+            {
+                size_t nLength = strlen(pSeqOfChars);
+                memcpy(_reserveEmpty(nLength), pSeqOfChars, nLength);
+            }
+        }
+
+        void _copyFromStringType(const stringType& strData)
+        {
+            if(strData._isShared() || strData._isExternal())
+            {
+                std::atomic<size_t>& nRefs = strData._isShared() ? strData._sharedHeader()->nRefs : strData._externalBlock()->nRefs;
+                nRefs.fetch_add(1, std::memory_order_relaxed);
+                _rep = strData._rep;
+                return;
+            }
+
+            size_t nLength = strData.length();
+            memcpy(_reserveEmpty(nLength), strData.c_str(), nLength);
+        }
+};
+
+static_assert(sizeof(stringType) == 3 * sizeof(void*), "stringType must stay three words");
+
+/**
+*   Lazy a + b (+ c ...) of stringType, const char* and other concatenations.
+*   Operands are captured as pointer + length, the total length once, nothing is copied
+*   until it becomes a stringType (construction, assignment or append).
+*/
+template <typename L, typename R>
+class stringTypeConcat
+{
+    public:
+        stringTypeConcat(const L& left, const R& right)
+            : _left(left), _right(right), _nLength(left.length() + right.length())
+        { }
+
+        size_t length() const
+        {
+            return _nLength;
+        }
+
+        char* copyTo(char* pDest) const
+        {
+            return _right.copyTo(_left.copyTo(pDest));
+        }
+
+    protected:
+        L _left;
+        R _right;
+        size_t _nLength;
+};
+
+// stringType, const char* and views all reach these through stringTypeView
+inline stringTypeConcat<stringTypeView, stringTypeView> operator+ (stringTypeView strLeft, stringTypeView strRight)
+{
+    return stringTypeConcat<stringTypeView, stringTypeView>(strLeft, strRight);
+}
+
+template <typename L, typename R>
+stringTypeConcat<stringTypeConcat<L, R>, stringTypeView> operator+ (const stringTypeConcat<L, R>& strLeft, stringTypeView strRight)
+{
+    return stringTypeConcat<stringTypeConcat<L, R>, stringTypeView>(strLeft, strRight);
+}
+
+template <typename L, typename R>
+stringTypeConcat<stringTypeView, stringTypeConcat<L, R>> operator+ (stringTypeView strLeft, const stringTypeConcat<L, R>& strRight)
+{
+    return stringTypeConcat<stringTypeView, stringTypeConcat<L, R>>(strLeft, strRight);
+}
+
+template <typename L1, typename R1, typename L2, typename R2>
+stringTypeConcat<stringTypeConcat<L1, R1>, stringTypeConcat<L2, R2>> operator+ (const stringTypeConcat<L1, R1>& strLeft, const stringTypeConcat<L2, R2>& strRight)
+{
+    return stringTypeConcat<stringTypeConcat<L1, R1>, stringTypeConcat<L2, R2>>(strLeft, strRight);
+}
+
+/**
+*   Transparent hasher and equality for hash indexes keyed by stringType: anything with hash()
+*   (stringType, stringTypeView, stringTypeAtom) hashes the same for the same characters,
+*   a stringType key reuses its cached hash. Heterogeneous lookups need C++20 unordered containers.
+*/
+struct stringTypeHasher
+{
+    typedef void is_transparent;
+
+    template <typename T>
+    auto operator() (const T& strKey) const -> decltype(static_cast<size_t>(strKey.hash()))
+    {
+        return static_cast<size_t>(strKey.hash());
+    }
+
+    size_t operator() (const char* pSeqOfChars) const
+    {
+        return static_cast<size_t>(stringTypeView(pSeqOfChars).hash());
+    }
+};
+
+struct stringTypeEqual
+{
+    typedef void is_transparent;
+
+    bool operator() (stringTypeView strLeft, stringTypeView strRight) const
+    {
+        return strLeft == strRight;
+    }
+};
+
+namespace std
+{
+    template <>
+    struct hash<stringType>
+    {
+        size_t operator() (const stringType& strKey) const noexcept
+        {
+            return static_cast<size_t>(strKey.hash());
+        }
+    };
+
+    template <>
+    struct hash<stringTypeView>
+    {
+        size_t operator() (stringTypeView strKey) const noexcept
+        {
+            return static_cast<size_t>(strKey.hash());
+        }
+    };
+}
+
+#endif // STRING_TYPE_H
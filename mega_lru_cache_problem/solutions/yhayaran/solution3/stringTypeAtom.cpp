@@ -0,0 +1,168 @@
+/*
+*   Description:            Intern table of stringTypeAtom (see stringTypeAtom.h).
+*                           64 shards picked by the top bits of the hash, each with its own mutex,
+*                           open addressing (linear probing) table and bump allocator for the entries:
+*                           threads interning different strings rarely wait for each other.
+*                           Ids index a two level directory, filled when an atom is added.
+*/
+#include "stringTypeAtom.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    struct EmptyAtom
+    {
+        stringTypeAtomEntry entry;
+        char cTerminator;
+    };
+
+    const EmptyAtom emptyAtom = {{0, 0, 0}, '\0'};
+
+    constexpr size_t nShardBits = 6;
+    constexpr size_t nShards = size_t(1) << nShardBits;
+    constexpr size_t nArenaBlock = 64 * 1024;   // entries are carved from blocks this big
+    constexpr size_t nIdChunkBits = 16;
+    constexpr size_t nIdChunk = size_t(1) << nIdChunkBits;
+
+    struct Shard
+    {
+        std::mutex shardMutex;
+        std::vector<const stringTypeAtomEntry*> slots = std::vector<const stringTypeAtomEntry*>(64, nullptr);
+        size_t nUsed = 0;
+        char* pArena = nullptr;
+        size_t nArenaLeft = 0;
+
+        // room for an entry of nLength characters, never given back
+        stringTypeAtomEntry* allocate(size_t nLength)
+        {
+            size_t nBytes = (sizeof(stringTypeAtomEntry) + nLength + 1 + alignof(stringTypeAtomEntry) - 1)
+                            & ~(alignof(stringTypeAtomEntry) - 1);
+            if (nBytes > nArenaBlock / 4)
+            {
+                return static_cast<stringTypeAtomEntry*>(::operator new(nBytes));
+            }
+            if (nBytes > nArenaLeft)
+            {
+                pArena = static_cast<char*>(::operator new(nArenaBlock));
+                nArenaLeft = nArenaBlock;
+            }
+            stringTypeAtomEntry* pEntry = reinterpret_cast<stringTypeAtomEntry*>(pArena);
+            pArena += nBytes;
+            nArenaLeft -= nBytes;
+            return pEntry;
+        }
+
+        void grow()
+        {
+            std::vector<const stringTypeAtomEntry*> bigger(slots.size() * 2, nullptr);
+            size_t nMask = bigger.size() - 1;
+            for (const stringTypeAtomEntry* pEntry : slots)
+            {
+                if (pEntry != nullptr)
+                {
+                    size_t i = pEntry->nHash & nMask;
+                    while (bigger[i] != nullptr)
+                    {
+                        i = (i + 1) & nMask;
+                    }
+                    bigger[i] = pEntry;
+                }
+            }
+            slots.swap(bigger);
+        }
+    };
+
+    struct AtomTable
+    {
+        Shard shards[nShards];
+        std::atomic<uint32_t> nNextId{1};
+        std::mutex idMutex;
+        std::atomic<std::atomic<const stringTypeAtomEntry*>*> idChunks[size_t(1) << (32 - nIdChunkBits)] = {};
+
+        void publish(const stringTypeAtomEntry* pEntry)
+        {
+            auto& chunk = idChunks[pEntry->nId >> nIdChunkBits];
+            std::atomic<const stringTypeAtomEntry*>* pChunk = chunk.load(std::memory_order_acquire);
+            if (pChunk == nullptr)
+            {
+                std::lock_guard<std::mutex> g(idMutex);
+                pChunk = chunk.load(std::memory_order_relaxed);
+                if (pChunk == nullptr)
+                {
+                    pChunk = new std::atomic<const stringTypeAtomEntry*>[nIdChunk]();
+                    chunk.store(pChunk, std::memory_order_release);
+                }
+            }
+            pChunk[pEntry->nId & (nIdChunk - 1)].store(pEntry, std::memory_order_release);
+        }
+
+        const stringTypeAtomEntry* find(uint32_t nId)
+        {
+            std::atomic<const stringTypeAtomEntry*>* pChunk = idChunks[nId >> nIdChunkBits].load(std::memory_order_acquire);
+            return pChunk != nullptr ? pChunk[nId & (nIdChunk - 1)].load(std::memory_order_acquire) : nullptr;
+        }
+    };
+
+    // never destroyed: atoms may be used by other static destructors
+    AtomTable& table()
+    {
+        static AtomTable* pTable = new AtomTable();
+        return *pTable;
+    }
+}
+
+const stringTypeAtomEntry* const stringTypeAtomEmpty = &emptyAtom.entry;
+
+const stringTypeAtomEntry* stringTypeAtom::_intern(stringTypeView strView)
+{
+    size_t nLength = strView.length();
+    if (nLength == 0)
+    {
+        return stringTypeAtomEmpty;
+    }
+
+    uint64_t nHash = stringTypeHash(strView.data(), nLength);
+    AtomTable& atoms = table();
+    Shard& shard = atoms.shards[nHash >> (64 - nShardBits)];
+
+    std::lock_guard<std::mutex> g(shard.shardMutex);
+    size_t nMask = shard.slots.size() - 1;
+    size_t i = nHash & nMask;
+    while (const stringTypeAtomEntry* pEntry = shard.slots[i])
+    {
+        if (pEntry->nHash == nHash && pEntry->nLength == nLength && memcmp(pEntry->c_str(), strView.data(), nLength) == 0)
+        {
+            return pEntry;
+        }
+        i = (i + 1) & nMask;
+    }
+
+    // new atom, the table stays at most half full
+    stringTypeAtomEntry* pEntry = shard.allocate(nLength);
+    pEntry->nHash = nHash;
+    pEntry->nId = atoms.nNextId.fetch_add(1, std::memory_order_relaxed);
+    pEntry->nLength = static_cast<uint32_t>(nLength);
+    memcpy(const_cast<char*>(pEntry->c_str()), strView.data(), nLength);
+    const_cast<char*>(pEntry->c_str())[nLength] = '\0';
+    atoms.publish(pEntry);
+
+    shard.slots[i] = pEntry;
+    if (++shard.nUsed * 2 > shard.slots.size())
+    {
+        shard.grow();
+    }
+    return pEntry;
+}
+
+stringTypeAtom stringTypeAtom::fromId(uint32_t nId)
+{
+    const stringTypeAtomEntry* pEntry = nId != 0 ? table().find(nId) : nullptr;
+    return stringTypeAtom(pEntry != nullptr ? pEntry : stringTypeAtomEmpty);
+}
+
+uint32_t stringTypeAtom::count()
+{
+    return table().nNextId.load(std::memory_order_relaxed);
+}
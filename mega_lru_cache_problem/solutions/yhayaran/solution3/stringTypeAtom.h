@@ -0,0 +1,136 @@
+/*
+*   Description:            Interned strings. stringTypeAtom is one pointer to the only copy of its characters,
+*                           shared by every atom of the same contents, in a process wide table (stringTypeAtom.cpp).
+*   Features Supported:     1. stringTypeAtom(view) finds or adds the characters, safe from any thread.
+*                           2. ==/!= and std::hash are a pointer compare and a precomputed hash.
+*                           3. A 32-bit id per atom (0 is the empty string), fromId() goes back.
+*                           4. Converts to stringTypeView, < orders like the characters so maps keyed
+*                              by atoms can still be searched with a view or a stringType.
+*   Lifetime:               Atoms are never freed: intern keys that repeat, not payloads.
+*/
+#ifndef STRING_TYPE_ATOM_H
+#define STRING_TYPE_ATOM_H
+
+#include "stringType.h"
+#include <functional>
+
+// one interned string: header, then the characters and the terminator
+struct stringTypeAtomEntry
+{
+    uint64_t nHash;
+    uint32_t nId;
+    uint32_t nLength;
+
+    const char* c_str() const
+    {
+        return reinterpret_cast<const char*>(this + 1);
+    }
+};
+
+// the empty string, id 0, what a default constructed atom points to
+extern const stringTypeAtomEntry* const stringTypeAtomEmpty;
+
+class stringTypeAtom
+{
+    public:
+        stringTypeAtom() : _pEntry(stringTypeAtomEmpty)
+        { }
+
+        // interns the characters: the first atom of these contents copies them, the others only look up
+        explicit stringTypeAtom(stringTypeView strView) : _pEntry(_intern(strView))
+        { }
+
+        // atom of an id returned by id(), the empty atom for ids never given
+        static stringTypeAtom fromId(uint32_t nId);
+
+        // atoms interned so far, the empty one included
+        static uint32_t count();
+
+        uint32_t id() const
+        {
+            return _pEntry->nId;
+        }
+
+        // stringTypeHash of the characters, computed once when interned
+        uint64_t hash() const
+        {
+            return _pEntry->nHash;
+        }
+
+        size_t length() const
+        {
+            return _pEntry->nLength;
+        }
+
+        const char* c_str() const
+        {
+            return _pEntry->c_str();
+        }
+
+        operator stringTypeView() const
+        {
+            return stringTypeView(c_str(), length());
+        }
+
+        friend bool operator== (stringTypeAtom atomLeft, stringTypeAtom atomRight)
+        {
+            return atomLeft._pEntry == atomRight._pEntry;
+        }
+
+        friend bool operator!= (stringTypeAtom atomLeft, stringTypeAtom atomRight)
+        {
+            return atomLeft._pEntry != atomRight._pEntry;
+        }
+
+        // same order as the characters (so as views), the pointer compare settles equal atoms
+        friend bool operator< (stringTypeAtom atomLeft, stringTypeAtom atomRight)
+        {
+            return atomLeft._pEntry != atomRight._pEntry && stringTypeView(atomLeft) < stringTypeView(atomRight);
+        }
+
+        friend bool operator> (stringTypeAtom atomLeft, stringTypeAtom atomRight)
+        {
+            return atomRight < atomLeft;
+        }
+
+        friend bool operator<= (stringTypeAtom atomLeft, stringTypeAtom atomRight)
+        {
+            return !(atomRight < atomLeft);
+        }
+
+        friend bool operator>= (stringTypeAtom atomLeft, stringTypeAtom atomRight)
+        {
+            return !(atomLeft < atomRight);
+        }
+
+    protected:
+        explicit stringTypeAtom(const stringTypeAtomEntry* pEntry) : _pEntry(pEntry)
+        { }
+
+        static const stringTypeAtomEntry* _intern(stringTypeView strView);
+
+        const stringTypeAtomEntry* _pEntry;
+};
+
+// for ordered containers that only need some order: one integer compare, not the characters'
+struct stringTypeAtomIdLess
+{
+    bool operator() (stringTypeAtom atomLeft, stringTypeAtom atomRight) const
+    {
+        return atomLeft.id() < atomRight.id();
+    }
+};
+
+namespace std
+{
+    template <>
+    struct hash<stringTypeAtom>
+    {
+        size_t operator() (stringTypeAtom atom) const noexcept
+        {
+            return static_cast<size_t>(atom.hash());
+        }
+    };
+}
+
+#endif // STRING_TYPE_ATOM_H
@@ -0,0 +1,316 @@
+/*
+*   Description:            stringTypeRope tree operations (see stringTypeRope.h).
+*                           The tree is an AVL tree without keys: _join concatenates two trees of any heights
+*                           in O(height difference) with the usual rotations, _prefix/_suffix split with joins.
+*/
+#include "stringTypeRope.h"
+#include <climits>
+#include <cerrno>
+#include <vector>
+#include <sys/uio.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+stringTypeRope::_NodePtr stringTypeRope::_leaf(const std::shared_ptr<const stringType>& pLeaf, size_t nOffset, size_t nLength)
+{
+    if(nLength == 0)
+    {
+        return nullptr;
+    }
+    return std::make_shared<const _Node>(_Node{nLength, 1, pLeaf, nOffset, nullptr, nullptr});
+}
+
+stringTypeRope::_NodePtr stringTypeRope::_node(const _NodePtr& pLeft, const _NodePtr& pRight)
+{
+    unsigned nHeight = 1 + (pLeft->nHeight > pRight->nHeight ? pLeft->nHeight : pRight->nHeight);
+    return std::make_shared<const _Node>(_Node{pLeft->nLength + pRight->nLength, nHeight, nullptr, 0, pLeft, pRight});
+}
+
+stringTypeRope::_NodePtr stringTypeRope::_join(const _NodePtr& pLeft, const _NodePtr& pRight)
+{
+    if(!pLeft)
+    {
+        return pRight;
+    }
+    if(!pRight)
+    {
+        return pLeft;
+    }
+
+    unsigned nLeft = pLeft->nHeight;
+    unsigned nRight = pRight->nHeight;
+    if(nLeft > nRight + 1)
+    {
+        // down the right spine of the taller tree, rebalance on the way back
+        _NodePtr pJoined = _join(pLeft->pRight, pRight);
+        if(pJoined->nHeight <= pLeft->pLeft->nHeight + 1)
+        {
+            return _node(pLeft->pLeft, pJoined);
+        }
+        if(_height(pJoined->pLeft) <= _height(pJoined->pRight))
+        {
+            return _node(_node(pLeft->pLeft, pJoined->pLeft), pJoined->pRight);
+        }
+        return _node(_node(pLeft->pLeft, pJoined->pLeft->pLeft), _node(pJoined->pLeft->pRight, pJoined->pRight));
+    }
+    if(nRight > nLeft + 1)
+    {
+        _NodePtr pJoined = _join(pLeft, pRight->pLeft);
+        if(pJoined->nHeight <= pRight->pRight->nHeight + 1)
+        {
+            return _node(pJoined, pRight->pRight);
+        }
+        if(_height(pJoined->pRight) <= _height(pJoined->pLeft))
+        {
+            return _node(pJoined->pLeft, _node(pJoined->pRight, pRight->pRight));
+        }
+        return _node(_node(pJoined->pLeft, pJoined->pRight->pLeft), _node(pJoined->pRight->pRight, pRight->pRight));
+    }
+    return _node(pLeft, pRight);
+}
+
+stringTypeRope::_NodePtr stringTypeRope::_prefix(const _NodePtr& pNode, size_t nCount)
+{
+    if(!pNode || nCount >= pNode->nLength)
+    {
+        return pNode;
+    }
+    if(nCount == 0)
+    {
+        return nullptr;
+    }
+    if(pNode->pLeaf)
+    {
+        return _leaf(pNode->pLeaf, pNode->nOffset, nCount);
+    }
+    if(nCount <= pNode->pLeft->nLength)
+    {
+        return _prefix(pNode->pLeft, nCount);
+    }
+    return _join(pNode->pLeft, _prefix(pNode->pRight, nCount - pNode->pLeft->nLength));
+}
+
+stringTypeRope::_NodePtr stringTypeRope::_suffix(const _NodePtr& pNode, size_t nFrom)
+{
+    if(!pNode || nFrom == 0)
+    {
+        return pNode;
+    }
+    if(nFrom >= pNode->nLength)
+    {
+        return nullptr;
+    }
+    if(pNode->pLeaf)
+    {
+        return _leaf(pNode->pLeaf, pNode->nOffset + nFrom, pNode->nLength - nFrom);
+    }
+    if(nFrom >= pNode->pLeft->nLength)
+    {
+        return _suffix(pNode->pRight, nFrom - pNode->pLeft->nLength);
+    }
+    return _join(_suffix(pNode->pLeft, nFrom), pNode->pRight);
+}
+
+void stringTypeRope::_closeTail()
+{
+    if(_strTail.length() == 0)
+    {
+        return;
+    }
+    size_t nLength = _strTail.length();
+    // under half full, a right sized copy (the second and last one of these characters):
+    // the leaf would otherwise pin the whole reserved chunk
+    std::shared_ptr<const stringType> pLeaf = nLength < nChunk / 2
+        ? std::make_shared<const stringType>(stringTypeView(_strTail))
+        : std::make_shared<const stringType>(std::move(_strTail));
+    _pRoot = _join(_pRoot, _leaf(pLeaf, 0, nLength));
+    _strTail = stringType();
+}
+
+void stringTypeRope::append(stringTypeView strView)
+{
+    if(strView.empty())
+    {
+        return;
+    }
+
+    if(_strTail.length() + strView.length() <= nChunk)
+    {
+        // reserved whole, so filling the chunk never moves what is already in it
+        if(_strTail.capacity() < nChunk)
+        {
+            _strTail.reserve(nChunk);
+        }
+        _strTail.append(strView);
+        return;
+    }
+
+    _closeTail();
+    if(strView.length() >= nChunk)
+    {
+        _pRoot = _join(_pRoot, _leaf(std::make_shared<const stringType>(strView), 0, strView.length()));
+        return;
+    }
+    _strTail.reserve(nChunk);
+    _strTail.append(strView);
+}
+
+void stringTypeRope::append(stringType&& strData)
+{
+    size_t nLength = strData.length();
+    if(nLength == 0)
+    {
+        return;
+    }
+    // short pieces would only make small leaves, their copy is cheap
+    if(nLength < nChunk / 16)
+    {
+        append(stringTypeView(strData));
+        return;
+    }
+    _closeTail();
+    _pRoot = _join(_pRoot, _leaf(std::make_shared<const stringType>(std::move(strData)), 0, nLength));
+}
+
+void stringTypeRope::append(const stringTypeRope& ropeOther)
+{
+    if(this == &ropeOther)
+    {
+        stringTypeRope ropeCopy(ropeOther);
+        append(ropeCopy);
+        return;
+    }
+    if(ropeOther._pRoot)
+    {
+        _closeTail();
+        _pRoot = _join(_pRoot, ropeOther._pRoot);
+    }
+    append(stringTypeView(ropeOther._strTail));
+}
+
+stringTypeRope stringTypeRope::substr(size_t nPos, size_t nCount) const
+{
+    size_t nLength = length();
+    if(nPos > nLength)
+    {
+        nPos = nLength;
+    }
+    if(nCount > nLength - nPos)
+    {
+        nCount = nLength - nPos;
+    }
+
+    stringTypeRope ropeResult;
+    size_t nTree = _pRoot ? _pRoot->nLength : 0;
+    if(nPos < nTree)
+    {
+        size_t nFromTree = nCount < nTree - nPos ? nCount : nTree - nPos;
+        ropeResult._pRoot = _prefix(_suffix(_pRoot, nPos), nFromTree);
+    }
+
+    // the part in our tail chunk is copied, at most nChunk characters
+    size_t nTailFrom = nPos > nTree ? nPos - nTree : 0;
+    size_t nTailEnd = nPos + nCount > nTree ? nPos + nCount - nTree : 0;
+    if(nTailEnd > nTailFrom)
+    {
+        ropeResult._strTail = _strTail.substr(nTailFrom, nTailEnd - nTailFrom);
+    }
+    return ropeResult;
+}
+
+char stringTypeRope::operator[] (size_t nPos) const
+{
+    const _Node* pNode = _pRoot.get();
+    if(pNode == nullptr || nPos >= pNode->nLength)
+    {
+        return _strTail.c_str()[nPos - (pNode ? pNode->nLength : 0)];
+    }
+    while(!pNode->pLeaf)
+    {
+        if(nPos < pNode->pLeft->nLength)
+        {
+            pNode = pNode->pLeft.get();
+        }
+        else
+        {
+            nPos -= pNode->pLeft->nLength;
+            pNode = pNode->pRight.get();
+        }
+    }
+    return pNode->pLeaf->c_str()[pNode->nOffset + nPos];
+}
+
+size_t stringTypeRope::_capacity(const _Node* pNode)
+{
+    size_t nCapacity = 0;
+    while(pNode != nullptr)
+    {
+        if(pNode->pLeaf)
+        {
+            return nCapacity + pNode->pLeaf->capacity();
+        }
+        nCapacity += _capacity(pNode->pLeft.get());
+        pNode = pNode->pRight.get();
+    }
+    return nCapacity;
+}
+
+size_t stringTypeRope::capacity() const
+{
+    return _capacity(_pRoot.get()) + _strTail.capacity();
+}
+
+ssize_t stringTypeRope::writeTo(int fd) const
+{
+    std::vector<iovec> chunks;
+    forEachChunk([&chunks](stringTypeView strChunk)
+    {
+        chunks.push_back(iovec{const_cast<char*>(strChunk.data()), strChunk.length()});
+    });
+
+    ssize_t nWritten = 0;
+    size_t nFirst = 0;
+    while(nFirst < chunks.size())
+    {
+        int nBatch = static_cast<int>(chunks.size() - nFirst < IOV_MAX ? chunks.size() - nFirst : IOV_MAX);
+        ssize_t nDone = ::writev(fd, &chunks[nFirst], nBatch);
+        if(nDone < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        if(nDone == 0)
+        {
+            // no progress: the output takes no more, retrying would spin
+            return nWritten;
+        }
+        nWritten += nDone;
+
+        // skip what went out, a partially written chunk is resumed where it stopped
+        size_t nLeft = static_cast<size_t>(nDone);
+        while(nFirst < chunks.size() && nLeft >= chunks[nFirst].iov_len)
+        {
+            nLeft -= chunks[nFirst].iov_len;
+            ++nFirst;
+        }
+        if(nLeft > 0)
+        {
+            chunks[nFirst].iov_base = static_cast<char*>(chunks[nFirst].iov_base) + nLeft;
+            chunks[nFirst].iov_len -= nLeft;
+        }
+    }
+    return nWritten;
+}
+
+stringType stringTypeRope::flatten() const
+{
+    stringType strFlat;
+    strFlat.reserve(length());
+    forEachChunk([&strFlat](stringTypeView strChunk) { strFlat.append(strChunk); });
+    return strFlat;
+}
@@ -0,0 +1,145 @@
+/*
+*   Description:            Rope of stringType chunks, for payloads built from many pieces (megabytes and more).
+*                           A balanced (AVL) tree of immutable leaves, each a slice of a shared stringType.
+*   Features Supported:     1. append: small pieces are copied once into a tail chunk (nChunk bytes, reserved up
+*                              front so it never reallocates), big ones get their own leaf, stringType&& is adopted.
+*                           2. Concatenation of ropes and substr (split) in O(log n), sharing the leaves.
+*                           3. forEachChunk / writeTo(fd) (writev) walk the characters without flattening,
+*                              flatten() makes one stringType with one allocation and one copy.
+*   Copies:                 Built with appends, every character is copied at most once before it is written out,
+*                           but for tail chunks closed under half full (a big or adopted piece came next):
+*                           those are copied once more, to their size, at most nChunk / 2 bytes per close.
+*/
+#ifndef STRING_TYPE_ROPE_H
+#define STRING_TYPE_ROPE_H
+
+#include "stringType.h"
+#include <memory>
+#include <sys/types.h>
+
+class stringTypeRope
+{
+    public:
+        static constexpr size_t nChunk = 64 * 1024;
+
+        stringTypeRope()
+        { }
+
+        explicit stringTypeRope(stringTypeView strView)
+        {
+            append(strView);
+        }
+
+        explicit stringTypeRope(stringType&& strData)
+        {
+            append(std::move(strData));
+        }
+
+        size_t length() const
+        {
+            return (_pRoot ? _pRoot->nLength : 0) + _strTail.length();
+        }
+
+        bool empty() const
+        {
+            return length() == 0;
+        }
+
+        // copies the characters once: into the tail chunk, or into their own leaf when they are big
+        void append(stringTypeView strView);
+
+        // takes the buffer, no copy (the tail chunk is closed first, order is kept)
+        void append(stringType&& strData);
+
+        // shares the other rope's leaves, copies its tail chunk (at most nChunk bytes)
+        void append(const stringTypeRope& ropeOther);
+
+        friend stringTypeRope operator+ (stringTypeRope ropeLeft, const stringTypeRope& ropeRight)
+        {
+            ropeLeft.append(ropeRight);
+            return ropeLeft;
+        }
+
+        // nCount characters from nPos (clamped), sharing the leaves
+        stringTypeRope substr(size_t nPos, size_t nCount = stringTypeNpos) const;
+
+        char operator[] (size_t nPos) const;
+
+        // f(stringTypeView) for each chunk, in order
+        template <typename F>
+        void forEachChunk(const F& f) const
+        {
+            _forEachChunk(_pRoot.get(), f);
+            if(_strTail.length() > 0)
+            {
+                f(stringTypeView(_strTail));
+            }
+        }
+
+        // writev of the chunks, IOV_MAX at a time, partial writes resumed; -1 and errno on error,
+        // short of length() when a writev wrote nothing
+        ssize_t writeTo(int fd) const;
+
+        // all the characters in one stringType: one allocation, one copy
+        stringType flatten() const;
+
+        // bytes of the buffers behind the leaves and the tail chunk (a buffer shared by leaves counts for each)
+        size_t capacity() const;
+
+        // height of the tree (0 when empty), O(log n) by construction
+        unsigned height() const
+        {
+            return _pRoot ? _pRoot->nHeight : 0;
+        }
+
+    protected:
+        struct _Node;
+        typedef std::shared_ptr<const _Node> _NodePtr;
+
+        // leaf: nLength characters from nOffset of *pLeaf; inner node: left then right
+        struct _Node
+        {
+            size_t nLength;
+            unsigned nHeight;
+            std::shared_ptr<const stringType> pLeaf;
+            size_t nOffset;
+            _NodePtr pLeft;
+            _NodePtr pRight;
+        };
+
+        static _NodePtr _leaf(const std::shared_ptr<const stringType>& pLeaf, size_t nOffset, size_t nLength);
+        static _NodePtr _node(const _NodePtr& pLeft, const _NodePtr& pRight);
+        static unsigned _height(const _NodePtr& pNode)
+        {
+            return pNode ? pNode->nHeight : 0;
+        }
+        static _NodePtr _join(const _NodePtr& pLeft, const _NodePtr& pRight);
+        static _NodePtr _prefix(const _NodePtr& pNode, size_t nCount);
+        static _NodePtr _suffix(const _NodePtr& pNode, size_t nFrom);
+
+        template <typename F>
+        static void _forEachChunk(const _Node* pNode, const F& f)
+        {
+            // the left side recursively, the right side in the loop: stack depth is the height
+            while(pNode != nullptr)
+            {
+                if(pNode->pLeaf)
+                {
+                    f(stringTypeView(pNode->pLeaf->c_str() + pNode->nOffset, pNode->nLength));
+                    return;
+                }
+                _forEachChunk(pNode->pLeft.get(), f);
+                pNode = pNode->pRight.get();
+            }
+        }
+
+        static size_t _capacity(const _Node* pNode);
+
+        // moves the tail chunk into the tree, copied to its size when it is under half a chunk
+        void _closeTail();
+
+        _NodePtr _pRoot;
+        stringType _strTail;
+};
+
+#endif // STRING_TYPE_ROPE_H
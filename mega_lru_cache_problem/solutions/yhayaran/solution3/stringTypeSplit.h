@@ -0,0 +1,144 @@
+/*
+*   Description:            Lazy split of characters into fields, for parsing delimited records.
+*                           Fields are stringTypeViews of the original characters: nothing is copied or
+*                           allocated, whatever the size of the text. Keep the text alive while they are used.
+*   Features Supported:     1. One delimiter (the character search kernel) or any of a stringTypeByteSet
+*                              (the byte set kernel), both SIMD (stringType.cpp).
+*                           2. Split: every field, empty ones too ("a,,b" -> "a" "" "b", "" -> "").
+*                              Tokens (bSkipEmpty): runs of delimiters count as one, no empty fields.
+*                           3. Range for loops (forward iterators) or next(strField) in a while loop.
+*/
+#ifndef STRING_TYPE_SPLIT_H
+#define STRING_TYPE_SPLIT_H
+
+#include "stringType.h"
+#include <iterator>
+
+class stringTypeSplit
+{
+    public:
+        stringTypeSplit(stringTypeView strText, char cDelimiter, bool bSkipEmpty = false)
+            : _strText(strText), _setOfDelimiters(stringTypeView(&cDelimiter, 1)), _bSkipEmpty(bSkipEmpty)
+        { }
+
+        stringTypeSplit(stringTypeView strText, const stringTypeByteSet& setOfDelimiters, bool bSkipEmpty = false)
+            : _strText(strText), _setOfDelimiters(setOfDelimiters), _bSkipEmpty(bSkipEmpty)
+        { }
+
+        class iterator
+        {
+            public:
+                typedef std::forward_iterator_tag iterator_category;
+                typedef stringTypeView value_type;
+                typedef ptrdiff_t difference_type;
+                typedef const stringTypeView* pointer;
+                typedef const stringTypeView& reference;
+
+                // the end
+                iterator()
+                { }
+
+                iterator(const stringTypeSplit* pSplit) : _pSplit(pSplit), _pRest(pSplit->_strText.data())
+                {
+                    ++*this;
+                }
+
+                reference operator* () const
+                {
+                    return _strField;
+                }
+
+                pointer operator-> () const
+                {
+                    return &_strField;
+                }
+
+                iterator& operator++ ()
+                {
+                    if(!_pSplit->_nextField(_pRest, _strField))
+                    {
+                        _pSplit = nullptr;
+                    }
+                    return *this;
+                }
+
+                iterator operator++ (int)
+                {
+                    iterator itOld(*this);
+                    ++*this;
+                    return itOld;
+                }
+
+                friend bool operator== (const iterator& itLeft, const iterator& itRight)
+                {
+                    return itLeft._pSplit == itRight._pSplit
+                        && (itLeft._pSplit == nullptr || itLeft._strField.data() == itRight._strField.data());
+                }
+
+                friend bool operator!= (const iterator& itLeft, const iterator& itRight)
+                {
+                    return !(itLeft == itRight);
+                }
+
+            protected:
+                const stringTypeSplit* _pSplit = nullptr;
+                const char* _pRest = nullptr;   // after the delimiter of the current field, nullptr after the last
+                stringTypeView _strField;
+        };
+
+        iterator begin() const
+        {
+            return iterator(this);
+        }
+
+        iterator end() const
+        {
+            return iterator();
+        }
+
+        // the next field into strField, false when there are no more: while(split.next(strField)) ...
+        bool next(stringTypeView& strField)
+        {
+            if(!_bStarted)
+            {
+                _bStarted = true;
+                _pRest = _strText.data();
+            }
+            return _nextField(_pRest, strField);
+        }
+
+    protected:
+        // the field starting at pRest, pRest moves past its delimiter (nullptr when it was the last one)
+        bool _nextField(const char*& pRest, stringTypeView& strField) const
+        {
+            const char* pEnd = _strText.data() + _strText.length();
+            while(pRest != nullptr)
+            {
+                size_t nRest = static_cast<size_t>(pEnd - pRest);
+                size_t nFound = stringTypeFindAnyOf(pRest, nRest, _setOfDelimiters);
+                if(nFound == stringTypeNpos)
+                {
+                    strField = stringTypeView(pRest, nRest);
+                    pRest = nullptr;
+                }
+                else
+                {
+                    strField = stringTypeView(pRest, nFound);
+                    pRest += nFound + 1;
+                }
+                if(!_bSkipEmpty || !strField.empty())
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        stringTypeView _strText;
+        stringTypeByteSet _setOfDelimiters;
+        bool _bSkipEmpty;
+        bool _bStarted = false;
+        const char* _pRest = nullptr;
+};
+
+#endif // STRING_TYPE_SPLIT_H
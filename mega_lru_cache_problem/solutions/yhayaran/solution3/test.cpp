@@ -1,7 +1,35 @@
 #include "lru_size_order.h"
+#include "lru_counting_resource.h"
+#include "stringTypeAtom.h"
+#include "stringTypeRope.h"
+#include "stringTypeSplit.h"
 #include <iostream>
+#include <random>
 #include <unistd.h>
 
+// stringType buffers come from new[] when they have no resource: counted here for the "no allocation" checks
+static std::atomic<int64_t> gArrayAllocations{0};
+
+void *operator new[](size_t size)
+{
+    gArrayAllocations.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(size);
+}
+
+void operator delete[](void *p) noexcept
+{
+    ::operator delete(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    ::operator delete(p);
+}
+
+static int64_t arrayAllocations()
+{
+    return gArrayAllocations.load(std::memory_order_relaxed);
+}
 
 class MyElement : public LRUCleanable
 {
@@ -9,6 +37,7 @@ private:
     std::string mSomeString;
     int mId;
     int64_t mSize = 10;
+    std::shared_ptr<LRUSizeObserver> mSizeObserver;
 
 public:
     MyElement(std::string name, int id) : mSomeString(name), mId(id) {}
@@ -32,9 +61,23 @@ public:
         return mSize;
     }
 
+    int64_t cacheSize()
+    {
+        return mSize;
+    }
+
     void setSize(int64_t s)
     {
         mSize = s;
+        if (mSizeObserver)
+        {
+            mSizeObserver->sizeChanged(mSize);
+        }
+    }
+
+    void setSizeObserver(const std::shared_ptr<LRUSizeObserver> &sizeObserver)
+    {
+        mSizeObserver = sizeObserver;
     }
 
 };
@@ -51,6 +94,20 @@ std::shared_ptr<MyElement> createElement(   const std::string &s,
     return e;
 }
 
+std::shared_ptr<MyElement> createElement(   const std::string &s,
+                                            const int id,
+                                            const int64_t size,
+                                            const size_t priority,
+                                            const uint32_t nameSpace,
+                                            LRUCache<MyElement, int> &cache )
+{
+    auto e = std::make_shared<MyElement>(s, id, size);
+
+    cache.updateElement(e, e->id(), e->size(), priority, nameSpace);
+    
+    return e;
+}
+
 std::shared_ptr<MyElement> createElement(   const std::string &s,
                                             const int id,
                                             const int64_t size,
@@ -182,10 +239,1356 @@ void test2()
     }
 }
 
+/**
+ * @brief Test to check priority classes.
+ * Cache, soft limit 50 bytes, hard limit 60 bytes, no cleaner thread
+ * 
+ * Testcase:
+ * 
+ * Element: Size Priority
+ * 
+ * A: 10B 1 (auth, total 10 Bytes)
+ * B: 10B 0 (total 20 Bytes)
+ * C: 10B 1 (auth, total 30 Bytes)
+ * D: 20B 0 (total 50 Bytes)
+ * E: 20B 0 (total 70 Bytes > hard limit, best-effort B and D go although A is older)
+ * reservation of priority 1 set to 20B
+ * F: 40B 0 (total 80 Bytes > hard limit, E goes, A/C are reserved so F stays over soft)
+ * 
+ * Pass: If messages with prefix 'Cleaned' comes in same order:
+ * Cleaned: Name: B ID: 2 Size: 0
+ * Cleaned: Name: D ID: 4 Size: 0
+ * Cleaned: Name: E ID: 5 Size: 0
+ */
+void test3()
+{
+    std::vector<std::shared_ptr<MyElement>> elements;
+
+    LRUCache<MyElement, int> cache(50, 60);
+
+    elements.push_back(createElement("A", 1, 10, 1, 0, cache));
+    elements.push_back(createElement("B", 2, 10, 0, 0, cache));
+    elements.push_back(createElement("C", 3, 10, 1, 0, cache));
+    elements.push_back(createElement("D", 4, 20, 0, 0, cache));
+    elements.push_back(createElement("E", 5, 20, 0, 0, cache));
+
+    cache.setPriorityReservation(1, 20);
+    elements.push_back(createElement("F", 6, 40, 0, 0, cache));
+
+    std::cout << "Priority 0: " << cache.prioritySize(0) << " Priority 1: " << cache.prioritySize(1) << std::endl;
+    for (auto &e : elements)
+    {
+        e->print();
+    }
+}
+
+void printStats(const char *name, const LRUNamespaceStats &stats)
+{
+    std::cout << name << " size: " << stats.size << " elements: " << stats.elements
+              << " inserts: " << stats.inserts << " evictions: " << stats.evictions
+              << " quota evictions: " << stats.quotaEvictions << std::endl;
+}
+
+/**
+ * @brief Test to check namespaces with quotas.
+ * Cache, soft limit 100 bytes, hard limit 200 bytes, no cleaner thread
+ * Namespace 1: soft quota 30 bytes, hard quota 50 bytes
+ * Namespace 2: soft quota 30 bytes, borrows idle capacity
+ * 
+ * Testcase:
+ * 
+ * Element: Size Namespace
+ * 
+ * A: 20B 2 (namespace 2 is 40 Bytes, above its quota but borrowing)
+ * B: 20B 2
+ * C: 20B 1
+ * D: 20B 1
+ * E: 20B 1 (namespace 1 is 60 Bytes > hard quota, trimmed to 20 Bytes: C, D go)
+ * F: 70B 0 (total 130 Bytes)
+ * cleanup() (total > soft limit, namespace 2 can't borrow anymore: A goes, then LRU: B goes)
+ * 
+ * Pass: If messages with prefix 'Cleaned' comes in same order:
+ * Cleaned: Name: C ID: 3 Size: 0
+ * Cleaned: Name: D ID: 4 Size: 0
+ * Cleaned: Name: A ID: 1 Size: 0
+ * Cleaned: Name: B ID: 2 Size: 0
+ */
+void test4()
+{
+    std::vector<std::shared_ptr<MyElement>> elements;
+
+    LRUCache<MyElement, int> cache(100, 200);
+    cache.setNamespaceQuota(1, 30, 50);
+    cache.setNamespaceQuota(2, 30, 0, true);
+
+    elements.push_back(createElement("A", 1, 20, 0, 2, cache));
+    elements.push_back(createElement("B", 2, 20, 0, 2, cache));
+    elements.push_back(createElement("C", 3, 20, 0, 1, cache));
+    elements.push_back(createElement("D", 4, 20, 0, 1, cache));
+    elements.push_back(createElement("E", 5, 20, 0, 1, cache));
+    elements.push_back(createElement("F", 6, 70, 0, 0, cache));
+
+    cache.cleanup();
+
+    printStats("Namespace 0", cache.namespaceStats(0));
+    printStats("Namespace 1", cache.namespaceStats(1));
+    printStats("Namespace 2", cache.namespaceStats(2));
+}
+
+/**
+ * @brief Test to check resize and size observers.
+ * Cache, soft limit 30 bytes, hard limit 60 bytes, no cleaner thread
+ * 
+ * Testcase:
+ * 
+ * A: 10B, B: 10B, C: 10B (total 30 Bytes)
+ * resize A to 15B (total 35 Bytes, A keeps being the least recently updated)
+ * cleanup() (A goes)
+ * D: 10B, holds a size observer (total 35 Bytes)
+ * D grows itself to 50B (total 75 Bytes > hard limit, B and C go, D is kept)
+ * 
+ * Pass: If messages with prefix 'Cleaned' comes in same order:
+ * Cleaned: Name: A ID: 1 Size: 0
+ * Cleaned: Name: B ID: 2 Size: 0
+ * Cleaned: Name: C ID: 3 Size: 0
+ */
+void test5()
+{
+    std::vector<std::shared_ptr<MyElement>> elements;
+
+    LRUCache<MyElement, int> cache(30, 60);
+
+    elements.push_back(createElement("A", 1, 10, cache));
+    elements.push_back(createElement("B", 2, 10, cache));
+    elements.push_back(createElement("C", 3, 10, cache));
+
+    cache.resize(1, 15);
+    cache.cleanup();
+
+    auto elementD = createElement("D", 4, 10, cache);
+    elementD->setSizeObserver(cache.sizeObserver(elementD->id()));
+    elements.push_back(elementD);
+    elementD->setSize(50);
+
+    std::cout << "Namespace 0 size: " << cache.namespaceStats(0).size << std::endl;
+    for (auto &e : elements)
+    {
+        e->print();
+    }
+}
+
+/**
+ * @brief Test to check sizes asked to the elements.
+ * Cache, soft limit 30 bytes, hard limit 60 bytes, no cleaner thread, lazy sizes
+ * 
+ * Testcase:
+ * 
+ * A: 10B, B: 10B, C: 10B, D: 10B, sizes taken from cacheSize() (total 40 Bytes)
+ * A shrinks to 0B without telling the cache
+ * cleanup() (A is asked again: total 30 Bytes, nothing goes)
+ * E: 10B (total 40 Bytes)
+ * cleanup() (A goes, then B)
+ * 
+ * Pass: If messages with prefix 'Cleaned' comes in same order:
+ * Cleaned: Name: A ID: 1 Size: 0
+ * Cleaned: Name: B ID: 2 Size: 0
+ */
+void test6()
+{
+    std::vector<std::shared_ptr<MyElement>> elements;
+
+    LRUCache<MyElement, int> cache(30, 60);
+    cache.setLazySize(true);
+
+    for (auto name : {"A", "B", "C", "D"})
+    {
+        auto e = std::make_shared<MyElement>(name, elements.size() + 1, 10);
+        cache.updateElement(e, e->id());
+        elements.push_back(e);
+    }
+
+    elements[0]->setSize(0);
+    cache.cleanup();
+    std::cout << "Namespace 0 size: " << cache.namespaceStats(0).size << std::endl;
+
+    auto elementE = std::make_shared<MyElement>("E", 5, 10);
+    cache.updateElement(elementE, elementE->id());
+    elements.push_back(elementE);
+    cache.cleanup();
+
+    for (auto &e : elements)
+    {
+        e->print();
+    }
+}
+
+/**
+ * @brief Element holding its payload in its own counting resource
+ */
+class PayloadElement : public LRUCleanable
+{
+private:
+    LRUCountingResource mResource;
+    std::pmr::vector<std::pmr::string> mLines{&mResource};
+
+public:
+    explicit PayloadElement(int64_t reportGranularity) : mResource(std::pmr::new_delete_resource(), reportGranularity) {}
+
+    void addLine(size_t length)
+    {
+        mLines.emplace_back(length, 'x');
+    }
+
+    void virtual cleanup()
+    {
+        mLines.clear();
+        mLines.shrink_to_fit();
+    }
+
+    LRUCountingResource &resource()
+    {
+        return mResource;
+    }
+
+    int64_t cacheSize()
+    {
+        return mResource.bytesInUse();
+    }
+};
+
+/**
+ * @brief Test to check accounting from counting resources.
+ * Cache, soft limit 64KB, hard limit 96KB, no cleaner thread
+ * 
+ * Testcase:
+ * 
+ * 16 elements get lines of growing lengths from their own counting resource, the cache is told 
+ * about the bytes in use every 256 bytes they move (trackResource). Lines up to 8KB make ~136KB,
+ * past the hard limit: the reports force cleanups, elements evicted get no more lines.
+ * 
+ * Pass: If elements were evicted, reported (cache total) and actual (sum of bytes in use of the cached
+ * elements) differ by less than 256 bytes per element, and the reported total ends under the hard limit.
+ */
+void test7()
+{
+    const int64_t granularity = 256;
+    std::vector<std::shared_ptr<PayloadElement>> elements;
+
+    LRUCache<PayloadElement, int> cache(64 * 1024, 96 * 1024);
+
+    for (int id = 0; id < 16; ++id)
+    {
+        auto e = std::make_shared<PayloadElement>(granularity);
+        e->addLine(100);
+        cache.updateElement(e, id);
+        trackResource(cache, id, e->resource());
+        elements.push_back(e);
+    }
+
+    for (size_t length = 16; length <= 8192; length *= 2)
+    {
+        for (int id = 0; id < 16; ++id)
+        {
+            if (cache.contains(id))
+                elements[id]->addLine(length);
+        }
+    }
+
+    int64_t actual = 0;
+    int cached = 0;
+    for (int id = 0; id < 16; ++id)
+    {
+        if (cache.contains(id))
+        {
+            actual += elements[id]->resource().bytesInUse();
+            cached++;
+        }
+    }
+    int64_t reported = cache.totalSize();
+
+    std::cout << "Reported: " << reported << " Actual: " << actual << " Cached: " << cached << std::endl;
+    assert(cached < 16);
+    assert(std::abs(reported - actual) < granularity * cached);
+    assert(reported <= 96 * 1024);
+}
+
+/**
+ * @brief Test to check lookups with keys that are not the primary key type.
+ * Cache keyed by stringType, soft limit 30 bytes, hard limit 60 bytes, no cleaner thread
+ * 
+ * Testcase:
+ * 
+ * A: 10B, B: 10B, C: 10B, D: 10B, keyed "user:1" to "user:4" (total 40 Bytes)
+ * commands parsed from one buffer, keys are stringTypeView (no stringType is built):
+ * DEL user:2 (B is removed without cleanup, total 30 Bytes)
+ * HAS user:9 (not cached)
+ * SET user:4 45 (total 65 Bytes > hard limit, A and C go, D is kept)
+ * 
+ * Pass: If messages with prefix 'Cleaned' comes in same order:
+ * Cleaned: Name: A ID: 1 Size: 0
+ * Cleaned: Name: C ID: 3 Size: 0
+ */
+void test8()
+{
+    std::vector<std::shared_ptr<MyElement>> elements;
+
+    LRUCache<MyElement, stringType> cache(30, 60);
+
+    for (auto name : {"A", "B", "C", "D"})
+    {
+        auto e = std::make_shared<MyElement>(name, elements.size() + 1, 10);
+        cache.updateElement(e, stringType("user:") + std::to_string(e->id()).c_str(), e->size());
+        elements.push_back(e);
+    }
+
+    stringType commands("DEL user:2\nHAS user:9\nSET user:4 45\n");
+    stringTypeView rest = commands;
+    while (!rest.empty())
+    {
+        stringTypeView line = rest.substr(0, rest.find('\n'));
+        rest.remove_prefix(line.length() + 1);
+
+        stringTypeView command = line.substr(0, line.find(' '));
+        stringTypeView key = line.substr(command.length() + 1);
+        stringTypeView arg;
+        if (key.find(' ') != stringTypeView::npos)
+        {
+            arg = key.substr(key.find(' ') + 1);
+            key = key.substr(0, key.find(' '));
+        }
+
+        if (command == "DEL")
+        {
+            cache.removeElement(key);
+            assert(!cache.contains(key));
+        }
+        else if (command == "HAS")
+        {
+            std::cout << key << (cache.contains(key) ? " cached" : " not cached") << std::endl;
+        }
+        else if (command == "SET")
+        {
+            [[maybe_unused]] bool resized = cache.resize(key, std::stoll(std::string(arg.data(), arg.length())));
+            assert(resized);
+        }
+    }
+
+    assert(cache.contains(stringType("user:4")));
+    assert(cache.totalSize() == 45);
+}
+
+/**
+ * @brief Test to check interned keys shared by several caches.
+ * Two caches keyed by stringTypeAtom, soft limit 20 bytes, hard limit 40 bytes, no cleaner thread
+ * 
+ * Testcase:
+ * 
+ * keys "tenant/1/session" and "tenant/2/session" interned once, used by both caches
+ * A, B: 10B each in the first cache, C, D: 10B each in the second (same two keys)
+ * the first cache drops the element found by a stringType key, the second by a view
+ * 
+ * Pass: no 'Cleaned' message, both caches hold one element and the keys have one copy.
+ */
+void test9()
+{
+    LRUCache<MyElement, stringTypeAtom> first(20, 40);
+    LRUCache<MyElement, stringTypeAtom> second(20, 40);
+    stringTypeAtom key1("tenant/1/session");
+    stringTypeAtom key2(stringType("tenant/") + "2/session");
+
+    auto a = std::make_shared<MyElement>("A", 1, 10);
+    auto b = std::make_shared<MyElement>("B", 2, 10);
+    auto c = std::make_shared<MyElement>("C", 3, 10);
+    auto d = std::make_shared<MyElement>("D", 4, 10);
+    first.updateElement(a, key1, a->size());
+    first.updateElement(b, key2, b->size());
+    second.updateElement(c, stringTypeAtom("tenant/1/session"), c->size());
+    second.updateElement(d, stringTypeAtom("tenant/2/session"), d->size());
+
+    first.removeElement(stringType("tenant/1/session"));
+    second.removeElement(stringTypeView("tenant/2/session"));
+
+    assert(!first.contains(key1) && first.contains(key2));
+    assert(second.contains(key1) && !second.contains(key2));
+    assert(stringTypeAtom("tenant/2/session").c_str() == key2.c_str());
+    std::cout << "Atoms: " << stringTypeAtom::count() << " Sizes: " << first.totalSize() << " " << second.totalSize() << std::endl;
+}
+
+/**
+ * @brief Test to check the adaptive policy picking size-then-LRU with its shadow caches.
+ * Cache keyed by int, soft limit 150 bytes, hard limit 1000 bytes, no cleaner thread,
+ * candidates LRU (live at the start) and size-then-LRU with no threshold, every key sampled,
+ * an epoch per round, a challenger must win 2 epochs in a row.
+ * 
+ * Testcase:
+ * 
+ * 3 rounds of: the hot elements A to E (10B each) updated, then two new big ones (101B to 106B)
+ * LRU at 150 bytes keeps only the last big one: no hit. Size-then-LRU drops the biggest: hot ones hit.
+ * After round 3 the cache runs size-then-LRU, cleanup() drops the big ones, biggest first.
+ * 
+ * Pass: If 'Policy: size-then-lru(0s) switches: 1' then messages with prefix 'Cleaned' comes in same order:
+ * Cleaned: Name: K ID: 11 Size: 0
+ * Cleaned: Name: J ID: 10 Size: 0
+ * Cleaned: Name: I ID: 9 Size: 0
+ * Cleaned: Name: H ID: 8 Size: 0
+ * Cleaned: Name: G ID: 7 Size: 0
+ * Cleaned: Name: F ID: 6 Size: 0
+ */
+void test10()
+{
+    LRUCache<MyElement, int> cache(150, 1000);
+    LRUPolicySelector::Options options;
+    options.sampleRate = 1;
+    options.epochAccesses = 7;
+    cache.enableAdaptivePolicy({LRUPolicy::lru(), LRUPolicy::sizeThenLRU(0)}, options);
+
+    std::vector<std::shared_ptr<MyElement>> elements;
+    for (auto name : {"A", "B", "C", "D", "E"})
+        elements.push_back(std::make_shared<MyElement>(name, elements.size() + 1, 10));
+
+    std::string bigNames = "FGHIJK";
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int hot = 0; hot < 5; ++hot)
+            cache.updateElement(elements[hot], hot + 1, elements[hot]->size());
+        for (int big = 0; big < 2; ++big)
+        {
+            int id = elements.size() + 1;
+            auto e = std::make_shared<MyElement>(bigNames.substr(id - 6, 1), id, 95 + id);
+            cache.updateElement(e, id, e->size());
+            elements.push_back(e);
+        }
+    }
+
+    auto stats = cache.policyStats();
+    std::cout << "Policy: " << cache.policy().name() << " switches: " << stats.switches << std::endl;
+    assert(stats.totalHitRatio[1] > stats.totalHitRatio[0]);
+    cache.cleanup();
+    assert(cache.totalSize() == 50);
+}
+
+/**
+ * @brief Test to check the miss-ratio curve estimated online.
+ * Cache keyed by int, soft limit 1000 bytes, hard limit 2000 bytes, no cleaner thread, every key sampled.
+ * 
+ * Testcase:
+ * 
+ * 3 rounds of: elements A to J (10B each) updated in the same order.
+ * Each update after the first round finds the 9 others updated since: an LRU cache needs 100 bytes to hit it.
+ * 
+ * Pass: If 'Hit ratio at 64B: 0.00 at 128B: 0.67' and no message with prefix 'Cleaned'
+ */
+void test11()
+{
+    LRUCache<MyElement, int> cache(1000, 2000);
+    cache.enableMissRatioCurve(64, 1);
+
+    std::vector<std::shared_ptr<MyElement>> elements;
+    for (auto name : {"A", "B", "C", "D", "E", "F", "G", "H", "I", "J"})
+        elements.push_back(std::make_shared<MyElement>(name, elements.size() + 1, 10));
+
+    for (int round = 0; round < 3; ++round)
+    {
+        for (auto &e : elements)
+            cache.updateElement(e, e->id(), e->size());
+    }
+
+    std::cout.precision(2);
+    std::cout << std::fixed << "Hit ratio at 64B: " << cache.hitRatioAt(64) << " at 128B: " << cache.hitRatioAt(128) << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+    auto curve = cache.missRatioCurve(16, 4096, 9);
+    assert(curve.size() == 9 && curve.front().second == 0 && curve.back().second > 0.66);
+}
+
+/**
+ * @brief Test to check the limits tuned along the miss-ratio curve.
+ * Cache keyed by int, soft limit 1000 bytes, hard limit 2000 bytes, no cleaner thread, every key sampled,
+ * tuning to a byte hit ratio of 0.6 with the soft limit between 50 and 1000 bytes, no damping.
+ * 
+ * Testcase:
+ * 
+ * 3 rounds of: elements A to J (10B each) updated in the same order, 100 bytes hit 2/3 of the updates.
+ * The soft limit goes down to the first size of the curve reaching 0.6, the hard limit to 1.25 times it.
+ * Then K (10B) is updated, cleanup() evicts the least recently updated to get under the new soft limit.
+ * 
+ * Pass: If 'Limits: 107 133' then messages with prefix 'Cleaned' comes in same order:
+ * Cleaned: Name: A ID: 1 Size: 0
+ */
+void test12()
+{
+    LRUCache<MyElement, int> cache(1000, 2000);
+    cache.enableMissRatioCurve(64, 1);
+    LRULimitTuning tuning;
+    tuning.targetHitRatio = 0.6;
+    tuning.minSoft = 50;
+    tuning.maxSoft = 1000;
+    tuning.damping = 1;
+    tuning.minUpdates = 30;
+    cache.enableLimitTuning(tuning);
+
+    std::vector<std::shared_ptr<MyElement>> elements;
+    for (auto name : {"A", "B", "C", "D", "E", "F", "G", "H", "I", "J"})
+        elements.push_back(std::make_shared<MyElement>(name, elements.size() + 1, 10));
+
+    for (int round = 0; round < 3; ++round)
+    {
+        for (auto &e : elements)
+            cache.updateElement(e, e->id(), e->size());
+    }
+
+    [[maybe_unused]] bool tuned = cache.tuneLimits();
+    [[maybe_unused]] bool tunedAgain = cache.tuneLimits(); // no update since
+    assert(tuned && !tunedAgain);
+    std::cout << "Limits: " << cache.maxSizeSoft() << " " << cache.maxSizeHard() << std::endl;
+
+    auto k = std::make_shared<MyElement>("K", 11, 10);
+    cache.updateElement(k, k->id(), k->size());
+    cache.cleanup();
+    assert(cache.totalSize() == 100);
+}
+
+/**
+ * @brief Test to check the eviction history counting premature evictions by reason.
+ * Cache keyed by int, soft limit 30 bytes, hard limit 60 bytes, no cleaner thread,
+ * history of 16 victims, an eviction is premature if the key comes back within an hour.
+ * 
+ * Testcase:
+ * 
+ * A, B, C, D (10B each) updated, cleanup() evicts A (LRU), A comes back.
+ * E (35B) goes over the hard limit: the forced cleanup evicts B, C, D, A. B comes back later.
+ * With size-then-LRU (no threshold), F (10B) updated, cleanup() evicts E (size-order), E comes back.
+ * 
+ * Pass: If 'Premature lru: 1/1 size-order: 1/1 hard-limit: 1/4 ghosts: 3' then messages with prefix 'Cleaned' comes in same order:
+ * Cleaned: Name: A ID: 1 Size: 0
+ * Cleaned: Name: B ID: 2 Size: 0
+ * Cleaned: Name: C ID: 3 Size: 0
+ * Cleaned: Name: D ID: 4 Size: 0
+ * Cleaned: Name: A ID: 1 Size: 0
+ * Cleaned: Name: E ID: 5 Size: 0
+ */
+void test13()
+{
+    LRUCache<MyElement, int> cache(30, 60);
+    cache.enableEvictionHistory(16, 3600);
+
+    std::vector<std::shared_ptr<MyElement>> elements;
+    auto update = [&](const char *name, int id, int64_t size)
+    {
+        auto e = std::make_shared<MyElement>(name, id, size);
+        elements.push_back(e);
+        cache.updateElement(e, id, size);
+    };
+
+    update("A", 1, 10);
+    update("B", 2, 10);
+    update("C", 3, 10);
+    update("D", 4, 10);
+    cache.cleanup();
+    update("A", 1, 10);
+
+    update("E", 5, 35);
+
+    cache.setPolicy(LRUPolicy::sizeThenLRU(0));
+    update("F", 6, 10);
+    cache.cleanup();
+    update("E", 5, 35);
+    update("B", 2, 10);
+
+    auto stats = cache.evictionHistoryStats();
+    std::cout << "Premature";
+    for (auto reason : {LRUEvictLRU, LRUEvictSizeOrder, LRUEvictHardLimit})
+        std::cout << " " << lruEvictionReasonName(reason) << ": " << LRUEvictionHistoryStats::total(stats.premature[reason])
+                  << "/" << LRUEvictionHistoryStats::total(stats.evictions[reason]);
+    std::cout << " ghosts: " << stats.ghosts << std::endl;
+    assert(stats.premature[LRUEvictSizeOrder][LRUEvictionHistoryStats::sizeClass(35)] == 1);
+    assert(stats.prematureRatio(LRUEvictHardLimit) == 0.25);
+}
+
+/**
+ * @brief Test to check a cache keyed by a type without std::hash (ordered only) builds and evicts:
+ * the features hashing keys stay out of its way while they are off.
+ * Cache keyed by std::pair<int,int>, soft limit 20 bytes, hard limit 40 bytes, no cleaner thread.
+ * 
+ * Testcase:
+ * 
+ * A, B, C (10B each) updated, cleanup() evicts A.
+ * 
+ * Pass: If messages with prefix 'Cleaned' comes in same order:
+ * Cleaned: Name: A ID: 1 Size: 0
+ */
+void test14()
+{
+    static_assert(!lruIsHashable<std::pair<int, int>>::value, "std::pair has no std::hash");
+    LRUCache<MyElement, std::pair<int, int>> cache(20, 40);
+
+    std::vector<std::shared_ptr<MyElement>> elements;
+    for (auto name : {"A", "B", "C"})
+    {
+        auto e = std::make_shared<MyElement>(name, elements.size() + 1, 10);
+        elements.push_back(e);
+        cache.updateElement(e, std::make_pair(e->id(), 0), e->size());
+    }
+    cache.cleanup();
+    assert(!cache.contains(std::make_pair(1, 0)) && cache.totalSize() == 20);
+}
+
+/**
+ * @brief Test to check a namespace with a hard quota only.
+ * Cache keyed by int, soft limit 1000 bytes, hard limit 2000 bytes, no cleaner thread,
+ * namespace 7 with no soft quota and a hard quota of 30 bytes.
+ * 
+ * Testcase:
+ * 
+ * A to E (10B each) updated in namespace 7: D and E go over the hard quota, each forced cleanup trims the namespace back to 30 bytes.
+ * 
+ * Pass: If 'Namespace 7: 30 bytes, quota evictions: 2' then messages with prefix 'Cleaned' comes in same order:
+ * Cleaned: Name: A ID: 1 Size: 0
+ * Cleaned: Name: B ID: 2 Size: 0
+ */
+void test15()
+{
+    LRUCache<MyElement, int> cache(1000, 2000);
+    cache.setNamespaceQuota(7, 0, 30);
+
+    std::vector<std::shared_ptr<MyElement>> elements;
+    for (auto name : {"A", "B", "C", "D", "E"})
+    {
+        auto e = std::make_shared<MyElement>(name, elements.size() + 1, 10);
+        elements.push_back(e);
+        cache.updateElement(e, e->id(), e->size(), 0, 7);
+    }
+
+    auto stats = cache.namespaceStats(7);
+    std::cout << "Namespace 7: " << stats.size << " bytes, quota evictions: " << stats.quotaEvictions << std::endl;
+    assert(stats.size == 30 && stats.quotaEvictions == 2);
+}
+
+/**
+ * @brief Test to check a rope built of small copied pieces and big adopted strings holds about its length.
+ * 
+ * Testcase:
+ * 
+ * 1000 rounds of a 10B append then a 4KB stringType&& append: each adopted string closes a tail chunk of 10 bytes.
+ * 
+ * Pass: If 'Rope: 4106000 bytes, capacity under 4.5MB: 1' and the characters are the ones appended
+ */
+void test16()
+{
+    std::string piece(4096, 'x');
+    std::string expected;
+    stringTypeRope rope;
+    for (int round = 0; round < 1000; ++round)
+    {
+        rope.append(stringTypeView("0123456789"));
+        rope.append(stringType(piece.data(), piece.length()));
+        expected += "0123456789" + piece;
+    }
+
+    bool small = rope.capacity() < 4500 * 1000;
+    std::cout << "Rope: " << rope.length() << " bytes, capacity under 4.5MB: " << small << std::endl;
+    assert(rope.length() == expected.length() && small);
+    stringType flat = rope.flatten();
+    assert(expected == flat.c_str());
+}
+
+/**
+ * @brief Test to check short strings (up to 23 characters) live inside the object.
+ * 
+ * Testcase:
+ * 
+ * "", "short key" and a 23 character string built, copied, appended to: no allocation, same characters as std::string.
+ * A 24th character moves the string to the heap: one allocation.
+ * 
+ * Pass: If 'SSO: 0 allocations up to 23 characters, 1 for 24'
+ */
+void test17()
+{
+    int64_t before = arrayAllocations();
+    stringType empty;
+    stringType key("short key");
+    stringType copy(key);
+    copy.append(":1234567890123");
+    std::string expected = std::string("short key") + ":1234567890123";
+    assert(empty.length() == 0 && empty.capacity() == 23);
+    assert(copy.length() == 23 && expected == copy.c_str() && key == "short key");
+    int64_t shortAllocations = arrayAllocations() - before;
+
+    before = arrayAllocations();
+    copy.append("5");
+    expected += "5";
+    int64_t longAllocations = arrayAllocations() - before;
+    assert(copy.length() == 24 && expected == copy.c_str());
+
+    std::cout << "SSO: " << shortAllocations << " allocations up to 23 characters, " << longAllocations << " for 24" << std::endl;
+    assert(shortAllocations == 0 && longAllocations == 1);
+}
+
+/**
+ * @brief Test to check appends grow the capacity geometrically and reserve makes room up front.
+ * 
+ * Testcase:
+ * 
+ * 100000 one character appends: the capacity doubles from 23, 13 allocations.
+ * reserve(200000) then 100000 more appends: the reserve is the only allocation.
+ * shrink_to_fit: capacity back to the length, same characters as std::string throughout.
+ * 
+ * Pass: If 'Growth: 13 allocations for 100000 appends, 1 with reserve'
+ */
+void test18()
+{
+    std::string expected;
+    stringType grown;
+    int64_t before = arrayAllocations();
+    for (int i = 0; i < 100000; ++i)
+    {
+        char c = static_cast<char>('a' + i % 26);
+        grown.append(stringTypeView(&c, 1));
+        expected += c;
+    }
+    int64_t growthAllocations = arrayAllocations() - before;
+    assert(expected == grown.c_str() && grown.capacity() >= grown.length());
+
+    before = arrayAllocations();
+    grown.reserve(200000);
+    assert(grown.capacity() >= 200000);
+    for (int i = 0; i < 100000; ++i)
+    {
+        char c = static_cast<char>('a' + i % 26);
+        grown.append(stringTypeView(&c, 1));
+        expected += c;
+    }
+    int64_t reserveAllocations = arrayAllocations() - before;
+    assert(expected == grown.c_str());
+
+    grown.shrink_to_fit();
+    assert(grown.capacity() == grown.length() && expected == grown.c_str());
+
+    std::cout << "Growth: " << growthAllocations << " allocations for 100000 appends, " << reserveAllocations << " with reserve" << std::endl;
+    assert(growthAllocations == 13 && reserveAllocations == 1);
+}
+
+/**
+ * @brief Test to check moves steal the buffer and + on a temporary appends to it in place.
+ * 
+ * Testcase:
+ * 
+ * A 40 character string moved into a new one, then move assigned to another: same buffer, sources left empty.
+ * The last one reserved to 100 and moved into a + with "-suffix": extended in place, no new buffer.
+ * 
+ * Pass: If 'Move: 0 allocations, buffer kept: 1'
+ */
+void test19()
+{
+    std::string expected(40, 'm');
+    stringType source(expected.data(), expected.length());
+    const char *buffer = source.c_str();
+
+    int64_t before = arrayAllocations();
+    stringType moved(std::move(source));
+    stringType assigned;
+    assigned = std::move(moved);
+    assert(source.length() == 0 && moved.length() == 0);
+    assert(expected == assigned.c_str());
+    bool kept = assigned.c_str() == buffer;
+    int64_t moveAllocations = arrayAllocations() - before;
+
+    assigned.reserve(100);
+    buffer = assigned.c_str();
+    before = arrayAllocations();
+    stringType joined = std::move(assigned) + "-suffix";
+    moveAllocations += arrayAllocations() - before;
+    kept = kept && joined.c_str() == buffer;
+    assert(expected + "-suffix" == joined.c_str());
+
+    std::cout << "Move: " << moveAllocations << " allocations, buffer kept: " << kept << std::endl;
+    assert(moveAllocations == 0 && kept);
+}
+
+/**
+ * @brief Test to check a + chain is materialized with one allocation.
+ * 
+ * Testcase:
+ * 
+ * Three 30 character strings joined with "/" literals and a view (a + "/" + b + "/" + c.substr(10)): one allocation.
+ * The same chain appended to an empty string: one allocation. Characters as std::string gives them.
+ * 
+ * Pass: If 'Concat: 1 allocation for a 5 piece chain, 1 for its append'
+ */
+void test20()
+{
+    std::string a(30, 'a'), b(30, 'b'), c = std::string(10, 'x') + std::string(20, 'c');
+    stringType strA(a.data(), a.length()), strB(b.data(), b.length()), strC(c.data(), c.length());
+
+    int64_t before = arrayAllocations();
+    stringType joined = strA + "/" + strB + "/" + strC.substr(10);
+    int64_t chainAllocations = arrayAllocations() - before;
+    std::string expected = a + "/" + b + "/" + c.substr(10);
+    assert(expected == joined.c_str());
+
+    stringType appended;
+    before = arrayAllocations();
+    appended.append(strA + "/" + strB + "/" + strC.substr(10));
+    int64_t appendAllocations = arrayAllocations() - before;
+    assert(appended == joined);
+
+    std::cout << "Concat: " << chainAllocations << " allocation for a 5 piece chain, " << appendAllocations << " for its append" << std::endl;
+    assert(chainAllocations == 1 && appendAllocations == 1);
+}
+
+/**
+ * @brief Test to check find and rfind give what std::string gives with each SIMD kernel the CPU runs.
+ * 
+ * Testcase:
+ * 
+ * With the kernels set to scalar, sse2 then avx2 (the CPU may lower them), 2000 random haystacks of 0 to 299
+ * characters (few distinct ones, so partial matches are frequent, high bytes included): find/rfind of a
+ * character and of needles of 1 to 40 characters cut from the haystack or random, from random positions.
+ * 
+ * Pass: If 'SIMD: 12000 finds match std::string at each level'
+ */
+void test21()
+{
+    const char alphabet[] = {'a', 'b', 'a', 'a', '\xe9', ' ', '\xff'};
+    int perLevel = 0;
+    for (const char *level : {"scalar", "sse2", "avx2"})
+    {
+        stringTypeSetSimdLevel(level);
+        std::mt19937 random(21);
+        int checks = 0;
+        for (int round = 0; round < 2000; ++round)
+        {
+            std::string haystack(random() % 300, 'a');
+            for (char &c : haystack)
+                c = alphabet[random() % sizeof(alphabet)];
+            stringType strHaystack(haystack.data(), haystack.length());
+
+            std::string needle;
+            size_t needleLength = 1 + random() % 40;
+            if (random() % 2 && needleLength <= haystack.length())
+                needle = haystack.substr(random() % (haystack.length() - needleLength + 1), needleLength);
+            else
+                for (size_t i = 0; i < needleLength; ++i)
+                    needle += alphabet[random() % sizeof(alphabet)];
+            stringTypeView strNeedle(needle.data(), needle.length());
+            [[maybe_unused]] size_t from = random() % (haystack.length() + 2);
+            [[maybe_unused]] char c = alphabet[random() % sizeof(alphabet)];
+
+            assert(strHaystack.find(strNeedle) == haystack.find(needle));
+            assert(strHaystack.find(strNeedle, from) == haystack.find(needle, from));
+            assert(strHaystack.rfind(strNeedle) == haystack.rfind(needle));
+            assert(strHaystack.rfind(strNeedle, from) == haystack.rfind(needle, from));
+            assert(strHaystack.find(c, from) == haystack.find(c, from));
+            assert(strHaystack.rfind(c, from) == haystack.rfind(c, from));
+            checks += 6;
+        }
+        perLevel = checks;
+    }
+    stringTypeSetSimdLevel(nullptr);
+    std::cout << "SIMD: " << perLevel << " finds match std::string at each level" << std::endl;
+}
+
+/**
+ * @brief Test to check share(): copies of a shared string point to one buffer until one of them changes.
+ * 
+ * Testcase:
+ * 
+ * A 100 character string shared (one allocation), copied three times: no allocation, 4 users of the same characters.
+ * One copy appended to: it copies the characters out (one allocation), the other three still share them unchanged.
+ * 
+ * Pass: If 'COW: 3 copies 0 allocations, write 1 allocation, users left: 3'
+ */
+void test22()
+{
+    std::string expected(100, 's');
+    stringType original(expected.data(), expected.length());
+
+    int64_t before = arrayAllocations();
+    original.share();
+    assert(original.isShared() && arrayAllocations() - before == 1);
+
+    before = arrayAllocations();
+    stringType copy1(original), copy2(copy1), copy3;
+    copy3 = copy2;
+    int64_t copyAllocations = arrayAllocations() - before;
+    assert(original.useCount() == 4 && copy3.c_str() == original.c_str());
+
+    before = arrayAllocations();
+    copy2.append("!");
+    int64_t writeAllocations = arrayAllocations() - before;
+    assert(!copy2.isShared() && copy2.c_str() != original.c_str());
+    assert(expected + "!" == copy2.c_str() && expected == original.c_str() && expected == copy3.c_str());
+
+    std::cout << "COW: 3 copies " << copyAllocations << " allocations, write " << writeAllocations
+              << " allocation, users left: " << original.useCount() << std::endl;
+    assert(copyAllocations == 0 && writeAllocations == 1 && copy1.useCount() == 3);
+}
+
+/**
+ * @brief Test to check strings built with a memory resource allocate from it and only from it.
+ * 
+ * Testcase:
+ * 
+ * A 50 character string of a LRUCountingResource: one allocation from it, none from new[].
+ * 1000 appends grow it from the resource, clear() keeps the buffer, a move keeps the resource.
+ * A copy goes to new[]; a move assignment to a string of no resource copies. All destroyed: nothing held.
+ * 
+ * Pass: If 'PMR: 1 resource allocation, 0 new[]; in use after destruction: 0'
+ */
+void test23()
+{
+    LRUCountingResource resource;
+    std::string expected(50, 'p');
+    {
+        int64_t before = arrayAllocations();
+        stringType pooled(stringTypeView(expected.data(), expected.length()), &resource);
+        int64_t resourceAllocations = resource.allocations();
+        int64_t newAllocations = arrayAllocations() - before;
+        assert(pooled.resource() == &resource && expected == pooled.c_str());
+
+        for (int i = 0; i < 1000; ++i)
+        {
+            pooled.append("x");
+            expected += "x";
+        }
+        assert(expected == pooled.c_str() && arrayAllocations() - before == 0);
+        [[maybe_unused]] int64_t held = resource.bytesInUse();
+        pooled.clear();
+        assert(pooled.length() == 0 && resource.bytesInUse() == held);
+        pooled.append(stringTypeView(expected.data(), expected.length()));
+
+        stringType moved(std::move(pooled));
+        assert(moved.resource() == &resource && resource.bytesInUse() == held);
+
+        stringType copy(moved);
+        stringType assigned;
+        assigned = std::move(moved);
+        assert(copy.resource() == nullptr && assigned.resource() == nullptr);
+        assert(expected == copy.c_str() && expected == assigned.c_str());
+
+        std::cout << "PMR: " << resourceAllocations << " resource allocation, " << newAllocations << " new[]; ";
+        assert(resourceAllocations == 1 && newAllocations == 0);
+    }
+    std::cout << "in use after destruction: " << resource.bytesInUse() << std::endl;
+    assert(resource.bytesInUse() == 0);
+}
+
+/**
+ * @brief Test to check the hash cached by long strings follows their changes.
+ * 
+ * Testcase:
+ * 
+ * Two equal 40 character strings hashed (cached), one changed by append, prepend (+ on a temporary),
+ * assignment of a view, clear, each time rehashed: the hash is the one of its new characters.
+ * Assigned back to the other's characters: the cached hashes agree and == holds.
+ * A shared string hashed, then a copy changed: the copy's hash follows, the shared one does not move.
+ * 
+ * Pass: If 'Hash: 6 changes, cached hashes follow the characters'
+ */
+void test24()
+{
+    std::string text(40, 'h');
+    stringType changed(text.data(), text.length()), same(text.data(), text.length());
+    [[maybe_unused]] uint64_t original = same.hash();
+    assert(changed.hash() == original && original == stringTypeHash(text.data(), text.length()));
+    assert(std::hash<stringType>()(same) == original);
+
+    int changes = 0;
+    auto check = [&](const std::string &expected)
+    {
+        assert(expected == changed.c_str());
+        assert(changed.hash() == stringTypeHash(expected.data(), expected.length()));
+        changes++;
+    };
+
+    changed.append("1");
+    check(text + "1");
+    changed = "0" + std::move(changed);
+    check("0" + text + "1");
+    changed = stringTypeView("a string of another length, long enough");
+    check("a string of another length, long enough");
+    changed.clear();
+    check("");
+    changed = stringTypeView(text.data(), text.length());
+    check(text);
+    assert(changed.hash() == original && changed == same);
+
+    stringType shared(std::string(50, 'c').c_str());
+    shared.share();
+    [[maybe_unused]] uint64_t sharedHash = shared.hash();
+    stringType copy(shared);
+    copy.append("d");
+    assert(copy.hash() == stringTypeHash((std::string(50, 'c') + "d").c_str(), 51));
+    changes++;
+    assert(shared.hash() == sharedHash && copy != shared);
+
+    std::cout << "Hash: " << changes << " changes, cached hashes follow the characters" << std::endl;
+}
+
+/**
+ * @brief Test to check comparisons order strings like std::string (bytes unsigned, a prefix first).
+ * 
+ * Testcase:
+ * 
+ * 3000 random pairs of 0 to 99 characters, often sharing a prefix, high bytes included: compare, <, <=, >, >=,
+ * == and commonPrefixLength agree with std::string. 200 strings sorted give the order std::string gives.
+ * A long string compared with a literal and a view of the same characters: no allocation.
+ * 
+ * Pass: If 'Compare: 3000 pairs ordered as std::string, 0 allocations against literals'
+ */
+void test25()
+{
+    std::mt19937 random(25);
+    auto randomText = [&random](const std::string &prefix)
+    {
+        std::string text = prefix.substr(0, random() % (prefix.length() + 1));
+        size_t length = random() % 100;
+        while (text.length() < length)
+            text += static_cast<char>(random() % 2 ? 'a' + random() % 3 : 0x7e + random() % 4);
+        return text;
+    };
+
+    std::vector<std::string> texts;
+    std::vector<stringType> strings;
+    int pairs = 0;
+    for (; pairs < 3000; ++pairs)
+    {
+        std::string left = randomText(""), right = randomText(left);
+        stringType strLeft(left.data(), left.length()), strRight(right.data(), right.length());
+        [[maybe_unused]] int expected = left.compare(right) < 0 ? -1 : (left.compare(right) > 0 ? 1 : 0);
+        assert(strLeft.view().compare(strRight) == expected);
+        assert((strLeft < strRight) == (left < right) && (strLeft <= strRight) == (left <= right));
+        assert((strLeft > strRight) == (left > right) && (strLeft >= strRight) == (left >= right));
+        assert((strLeft == strRight) == (left == right) && (strLeft != strRight) == (left != right));
+        size_t common = 0;
+        while (common < left.length() && common < right.length() && left[common] == right[common])
+            common++;
+        assert(strLeft.view().commonPrefixLength(strRight) == common);
+        if (texts.size() < 200)
+        {
+            texts.push_back(left);
+            strings.push_back(strLeft);
+        }
+    }
+    std::sort(texts.begin(), texts.end());
+    std::sort(strings.begin(), strings.end());
+    for (size_t i = 0; i < texts.size(); ++i)
+        assert(texts[i] == strings[i].c_str());
+
+    stringType literal("a literal longer than the inline twenty three characters");
+    int64_t before = arrayAllocations();
+    [[maybe_unused]] bool equal = literal == "a literal longer than the inline twenty three characters"
+        && "a literal longer than the inline twenty three characters" == literal
+        && !(literal != stringTypeView(literal.c_str(), literal.length()))
+        && literal != "a literal longer than the inline twenty three characters, and more";
+    int64_t literalAllocations = arrayAllocations() - before;
+    assert(equal);
+
+    std::cout << "Compare: " << pairs << " pairs ordered as std::string, " << literalAllocations << " allocations against literals" << std::endl;
+    assert(literalAllocations == 0);
+}
+
+/**
+ * @brief Test to check a rope holds the characters appended to it, in order, whatever way they came in.
+ * 
+ * Testcase:
+ * 
+ * 400 random appends, copied views of 1 byte to 100KB (some over nChunk), adopted stringType&& and other ropes,
+ * mirrored in a std::string: flatten(), operator[] and the chunks give the std::string.
+ * 200 random substr give std::string::substr. writeTo a temporary file writes all of it, read back equal.
+ * 
+ * Pass: If 'Rope: 200 substr and the file match std::string, height under 40: 1'
+ */
+void test26()
+{
+    std::mt19937 random(26);
+    auto randomText = [&random](size_t length)
+    {
+        std::string text(length, 'a');
+        for (char &c : text)
+            c = static_cast<char>('a' + random() % 26);
+        return text;
+    };
+
+    stringTypeRope rope;
+    std::string expected;
+    for (int i = 0; i < 400; ++i)
+    {
+        size_t length = random() % 8 ? 1 + random() % 2000 : 1 + random() % (100 * 1024);
+        std::string text = randomText(length);
+        switch (random() % 3)
+        {
+        case 0:
+            rope.append(stringTypeView(text.data(), text.length()));
+            break;
+        case 1:
+            rope.append(stringType(text.data(), text.length()));
+            break;
+        default:
+            rope = rope + stringTypeRope(stringTypeView(text.data(), text.length()));
+            break;
+        }
+        expected += text;
+    }
+
+    assert(rope.length() == expected.length());
+    assert(expected == rope.flatten().c_str());
+    std::string chunks;
+    rope.forEachChunk([&chunks](stringTypeView chunk) { chunks.append(chunk.data(), chunk.length()); });
+    assert(chunks == expected);
+    for (int i = 0; i < 1000; ++i)
+    {
+        [[maybe_unused]] size_t pos = random() % expected.length();
+        assert(rope[pos] == expected[pos]);
+    }
+
+    int substrs = 0;
+    for (; substrs < 200; ++substrs)
+    {
+        size_t pos = random() % (expected.length() + 10);
+        size_t count = random() % 2 ? random() % 200000 : stringTypeNpos;
+        stringTypeRope part = rope.substr(pos, count);
+        std::string expectedPart = pos <= expected.length() ? expected.substr(pos, count) : "";
+        assert(part.length() == expectedPart.length() && expectedPart == part.flatten().c_str());
+    }
+
+    char path[] = "/tmp/stringTypeRopeXXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    unlink(path);
+    [[maybe_unused]] ssize_t writtenLength = rope.writeTo(fd);
+    assert(writtenLength == static_cast<ssize_t>(expected.length()));
+    std::string written(expected.length(), '\0');
+    [[maybe_unused]] ssize_t readLength = pread(fd, &written[0], written.length(), 0);
+    assert(readLength == static_cast<ssize_t>(written.length()));
+    close(fd);
+    assert(written == expected);
+
+    std::cout << "Rope: " << substrs << " substr and the file match std::string, height under 40: " << (rope.height() < 40) << std::endl;
+    assert(rope.height() < 40);
+}
+
+/**
+ * @brief Test to check adopt(), mapFile() and release() hand buffers over without copying the characters.
+ * 
+ * Testcase:
+ * 
+ * A 40 character new[] buffer adopted and copied: same characters, no new[], the deleter runs once, after the last copy.
+ * An adopted copy appended to: its characters are copied out, the buffer is not written.
+ * release() of an adopted string gives the buffer and its deleter back, of a long string its own buffer,
+ * of a short one a copy. mapFile of a 10000 character file: the file's characters, adopted; of a missing one: empty.
+ * 
+ * Pass: If 'Adopt: 0 new[], deleter calls: 1; release kept 2 buffers; mapFile: 10000 characters'
+ */
+void test27()
+{
+    std::string text(40, 'o');
+    int deleted = 0;
+    auto deleter = [&deleted](char *p, size_t) { deleted++; delete[] p; };
+
+    char *buffer = new char[text.length() + 1];
+    memcpy(buffer, text.c_str(), text.length() + 1);
+    int64_t before = arrayAllocations();
+    {
+        stringType adopted = stringType::adopt(buffer, text.length(), deleter);
+        stringType copy(adopted);
+        assert(adopted.isAdopted() && copy.c_str() == buffer && adopted.useCount() == 2);
+        int64_t adoptAllocations = arrayAllocations() - before;
+        copy.append("!");
+        assert(copy.c_str() != buffer && text + "!" == copy.c_str() && text == buffer);
+        std::cout << "Adopt: " << adoptAllocations << " new[], ";
+        assert(adoptAllocations == 0 && deleted == 0);
+    }
+    std::cout << "deleter calls: " << deleted << "; ";
+    assert(deleted == 1);
+
+    buffer = new char[text.length() + 1];
+    memcpy(buffer, text.c_str(), text.length() + 1);
+    stringType adopted = stringType::adopt(buffer, text.length(), deleter);
+    stringTypeReleased released = adopted.release();
+    int kept = released.pSeqOfChars == buffer;
+    assert(adopted.length() == 0 && released.nLength == text.length());
+    released.deleter(released.pSeqOfChars, released.nLength);
+    assert(deleted == 2);
+
+    stringType owned(text.data(), text.length());
+    const char *ownedBuffer = owned.c_str();
+    released = owned.release();
+    kept += released.pSeqOfChars == ownedBuffer;
+    assert(text == released.pSeqOfChars);
+    released.deleter(released.pSeqOfChars, released.nLength);
+
+    stringType shortString("short");
+    released = shortString.release();
+    assert(std::string("short") == released.pSeqOfChars && released.nLength == 5);
+    released.deleter(released.pSeqOfChars, released.nLength);
+    std::cout << "release kept " << kept << " buffers; ";
+
+    char path[] = "/tmp/stringTypeMapXXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    std::string contents(10000, 'f');
+    contents[5000] = '\n';
+    [[maybe_unused]] ssize_t fileLength = write(fd, contents.data(), contents.length());
+    assert(fileLength == static_cast<ssize_t>(contents.length()));
+    close(fd);
+    {
+        stringType mapped = stringType::mapFile(path);
+        assert(mapped.isAdopted() && contents == mapped.c_str() && mapped.find('\n') == 5000);
+        std::cout << "mapFile: " << mapped.length() << " characters" << std::endl;
+    }
+    unlink(path);
+    stringType missing = stringType::mapFile(path);
+    assert(missing.length() == 0 && errno == ENOENT);
+    assert(kept == 2);
+}
+
+/**
+ * @brief Test to check splits into fields and tokens, and findAnyOf, with each SIMD kernel the CPU runs.
+ * 
+ * Testcase:
+ * 
+ * 1000 random texts of 0 to 199 characters with the delimiters ',', ';', '\t' and '\xe9' among others:
+ * findAnyOf from random positions gives std::string::find_first_of, every field (empty ones too) and every
+ * token (runs of delimiters as one) give a reference split in std::string, with a byte set and with ';' alone.
+ * The fields are views of the text: no new[] while splitting.
+ * 
+ * Pass: If 'Split: 1000 texts split as std::string at each level, 0 allocations'
+ */
+void test28()
+{
+    const char alphabet[] = {'a', 'b', 'c', ',', ';', '\t', '\xe9', '\xea', ' '};
+    const std::string delimiters(",;\t\xe9");
+    auto reference = [](const std::string &text, const std::string &delimiters, bool skipEmpty)
+    {
+        std::vector<std::string> fields;
+        size_t start = 0;
+        while (true)
+        {
+            size_t found = text.find_first_of(delimiters, start);
+            std::string field = text.substr(start, found == std::string::npos ? std::string::npos : found - start);
+            if (!skipEmpty || !field.empty())
+                fields.push_back(field);
+            if (found == std::string::npos)
+                return fields;
+            start = found + 1;
+        }
+    };
+
+    int texts = 0;
+    int64_t splitAllocations = 0;
+    stringTypeByteSet setOfDelimiters(stringTypeView(delimiters.data(), delimiters.length()));
+    for (const char *level : {"scalar", "sse2", "avx2"})
+    {
+        stringTypeSetSimdLevel(level);
+        std::mt19937 random(28);
+        for (texts = 0; texts < 1000; ++texts)
+        {
+            std::string text(random() % 200, 'a');
+            for (char &c : text)
+                c = alphabet[random() % sizeof(alphabet)];
+            stringType strText(text.data(), text.length());
+            size_t from = random() % (text.length() + 1);
+            [[maybe_unused]] size_t expected = text.find_first_of(delimiters, from);
+            assert(strText.view().findAnyOf(setOfDelimiters, from) == (from < text.length() ? expected : stringTypeNpos));
+
+            std::vector<std::string> fields = reference(text, delimiters, false);
+            std::vector<std::string> tokens = reference(text, delimiters, true);
+            std::vector<std::string> semicolonFields = reference(text, ";", false);
+            int64_t before = arrayAllocations();
+            size_t i = 0;
+            for ([[maybe_unused]] stringTypeView field : stringTypeSplit(strText, setOfDelimiters))
+            {
+                assert(i < fields.size() && field == stringTypeView(fields[i].c_str()));
+                i++;
+            }
+            assert(i == fields.size());
+
+            stringTypeSplit tokenSplit(strText, setOfDelimiters, true);
+            stringTypeView token;
+            for (i = 0; tokenSplit.next(token); ++i)
+                assert(i < tokens.size() && token == stringTypeView(tokens[i].c_str()));
+            assert(i == tokens.size());
+
+            i = 0;
+            for ([[maybe_unused]] stringTypeView field : stringTypeSplit(strText, ';'))
+            {
+                assert(i < semicolonFields.size() && field == stringTypeView(semicolonFields[i].c_str()));
+                i++;
+            }
+            assert(i == semicolonFields.size());
+            splitAllocations += arrayAllocations() - before;
+        }
+    }
+    stringTypeSetSimdLevel(nullptr);
+
+    std::cout << "Split: " << texts << " texts split as std::string at each level, " << splitAllocations << " allocations" << std::endl;
+    assert(splitAllocations == 0);
+}
+
+/**
+ * @brief Test to check LRUCacheSizeOrder::resize keeps the resized element when it forces a cleanup.
+ * Cache, soft limit 30 bytes, hard limit 60 bytes, no threshold or cleaner thread
+ * 
+ * Testcase:
+ * 
+ * A, B, C (10B each, total 30 Bytes)
+ * A resized to 50B in place (still the oldest, total 70 Bytes > hard limit): B and C go, A stays (total 50 Bytes)
+ * A resized back to 10B (total 10 Bytes)
+ * 
+ * Pass: If 'Resized A: cached 1, total 10' comes after messages with prefix 'Cleaned' in same order:
+ * Cleaned: Name: B ID: 2 Size: 0
+ * Cleaned: Name: C ID: 3 Size: 0
+ */
+void test29()
+{
+    std::vector<std::shared_ptr<MyElement>> elements;
+    LRUCacheSizeOrder<MyElement, int> cache(30, 60);
+
+    elements.push_back(createElement("A", 1, 10, cache));
+    elements.push_back(createElement("B", 2, 10, cache));
+    elements.push_back(createElement("C", 3, 10, cache));
+
+    [[maybe_unused]] bool resized = cache.resize(1, 50);
+    assert(resized && cache.contains(1) && !cache.contains(2) && !cache.contains(3));
+    assert(cache.totalSize() == 50);
+
+    resized = cache.resize(1, 10);
+    assert(resized);
+    std::cout << "Resized A: cached " << cache.contains(1) << ", total " << cache.totalSize() << std::endl;
+    assert(cache.contains(1) && cache.totalSize() == 10);
+}
+
 int main()
 {
     //test1();
     test2();
+    test3();
+    test4();
+    test5();
+    test6();
+    test7();
+    test8();
+    test9();
+    test10();
+    test11();
+    test12();
+    test13();
+    test14();
+    test15();
+    test16();
+    test17();
+    test18();
+    test19();
+    test20();
+    test21();
+    test22();
+    test23();
+    test24();
+    test25();
+    test26();
+    test27();
+    test28();
+    test29();
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,426 @@
+/*
+*   Description:            Exact byte miss-ratio curve of LRUCache from a captured trace, every size in one pass
+*                           (Mattson stack algorithm, make mrc). The online estimate is LRUMissRatioCurve.
+*   Trace:                  Binary, little-endian records of 16 bytes: uint64 key (e.g. lruKeyHash of the
+*                           cache key), uint32 size in bytes, uint32 op: 0 updateElement, 1 removeElement.
+*   Model:                  A cache with a soft limit of X bytes, cleaned after every update, holds a key until
+*                           X is smaller than its size plus the bytes of the distinct keys updated since (its byte
+*                           reuse distance). A removed key misses on its next update, at any size. Exact when
+*                           keys keep their size and are not removed. Otherwise a cache may have dropped a key
+*                           while more bytes than now were above it: removed keys are kept in the stack until
+*                           they come back (a bit pessimistic, hundredths of a point on mixed traces), a key
+*                           that shrank is counted at its new size (a bit optimistic).
+*   Method:                 Reuse distances from a Fenwick tree of the key sizes indexed by update time (an
+*                           order-statistics tree of the recency stack, by blocks): O(log n) per update. The time axis is
+*                           renumbered when it fills, so memory follows the distinct keys, not the trace length.
+*                           Distances go in buckets exact below 2^precision, then 2^precision per power of two.
+*   Output:                 CSV: cache_bytes,byte_hit_ratio,object_hit_ratio, exact at each size printed (the
+*                           last size of each bucket holding distances), from --min to --max bytes.
+*   Usage:                  lruMrc [--precision 6] [--min BYTES] [--max BYTES] TRACE|-
+*/
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct TraceRecord
+    {
+        uint64_t key;
+        uint32_t size;
+        uint32_t op;
+    };
+    static_assert(sizeof(TraceRecord) == 16, "trace records are 16 bytes");
+
+    enum TraceOp
+    {
+        OpUpdate = 0,
+        OpRemove = 1
+    };
+
+    /**
+     * @brief KeyTable open addressing (linear probing) table of the keys in the stack: when each was last
+     * updated and its size then. A few words per key, no node allocation, as traces hold up to billions of updates.
+     * Keys never leave it: a removed key stays in the stack (see RecencyStack::remove).
+     */
+    class KeyTable
+    {
+    public:
+        struct Slot
+        {
+            uint64_t key;
+            uint64_t stamp; // 0: empty
+            int64_t size;
+            bool removed;
+        };
+
+    private:
+        std::vector<Slot> mSlots;
+        size_t mKeys = 0;
+
+        static uint64_t mix(uint64_t key)
+        {
+            key ^= key >> 30;
+            key *= 0xbf58476d1ce4e5b9ULL;
+            key ^= key >> 27;
+            key *= 0x94d049bb133111ebULL;
+            key ^= key >> 31;
+            return key;
+        }
+
+        void grow()
+        {
+            std::vector<Slot> old;
+            old.swap(mSlots);
+            mSlots.assign(std::max<size_t>(1024, 2 * old.size()), Slot{0, 0, 0, false});
+            mKeys = 0;
+            for (const Slot &slot : old)
+            {
+                if (slot.stamp != 0)
+                    *insert(slot.key) = slot;
+            }
+        }
+
+    public:
+        KeyTable()
+        {
+            grow();
+        }
+
+        Slot *find(uint64_t key)
+        {
+            size_t mask = mSlots.size() - 1;
+            for (size_t i = mix(key) & mask;; i = (i + 1) & mask)
+            {
+                Slot &slot = mSlots[i];
+                if (slot.stamp == 0)
+                    return nullptr;
+                if (slot.key == key)
+                    return &slot;
+            }
+        }
+
+        // a slot for a key not in the table, its stamp must be set before anything else is inserted
+        Slot *insert(uint64_t key)
+        {
+            if ((mKeys + 1) * 2 > mSlots.size())
+                grow();
+            size_t mask = mSlots.size() - 1;
+            size_t i = mix(key) & mask;
+            while (mSlots[i].stamp != 0)
+                i = (i + 1) & mask;
+            mKeys++;
+            mSlots[i] = Slot{key, 0, 0, false};
+            return &mSlots[i];
+        }
+
+        size_t keys() const
+        {
+            return mKeys;
+        }
+
+        // slots by index, for a scan of the keys in table order
+        size_t capacity() const
+        {
+            return mSlots.size();
+        }
+
+        Slot &slot(size_t index)
+        {
+            return mSlots[index];
+        }
+    };
+
+    /**
+     * @brief RecencyStack byte weighted LRU stack: the bytes of the keys updated after a given update.
+     * Sizes by stamp in a flat array, their sums by blocks of 64 stamps in a Fenwick tree: a query reads
+     * the small tree (it stays in cache) and part of one block, where a tree of every stamp misses the cache
+     * at most of its levels once the trace holds millions of keys.
+     */
+    class RecencyStack
+    {
+    private:
+        static constexpr int kBlockBits = 6;
+
+        KeyTable mTable;
+        std::vector<int64_t> mSizes;    // size of the key last updated at each stamp, 0 once it is updated again
+        std::vector<int64_t> mBlocks;   // Fenwick tree of the sums of mSizes by block, 1-based
+        uint64_t mClock = 0;
+        int64_t mTotalBytes = 0;
+
+        void add(uint64_t stamp, int64_t size)
+        {
+            mSizes[stamp] += size;
+            for (uint64_t block = (stamp >> kBlockBits) + 1; block < mBlocks.size(); block += block & (~block + 1))
+                mBlocks[block] += size;
+        }
+
+        // bytes updated after stamp
+        int64_t after(uint64_t stamp) const
+        {
+            uint64_t block = stamp >> kBlockBits;
+            int64_t sum = mTotalBytes;
+            for (uint64_t i = block; i > 0; i -= i & (~i + 1))
+                sum -= mBlocks[i];
+            for (uint64_t i = block << kBlockBits; i <= stamp; ++i)
+                sum -= mSizes[i];
+            return sum;
+        }
+
+        // renumbers the keys 1..n in recency order, 4 times as many stamps as keys so it comes every 3n updates at most.
+        // The table is scanned in its own order: no lookup by key, no key kept per stamp.
+        void renumber()
+        {
+            const size_t none = ~size_t(0);
+            std::vector<size_t> slotByStamp(mClock + 1, none);
+            for (size_t index = 0; index < mTable.capacity(); ++index)
+            {
+                if (mTable.slot(index).stamp != 0)
+                    slotByStamp[mTable.slot(index).stamp] = index;
+            }
+
+            size_t capacity = std::max<size_t>(1024, 4 * (mTable.keys() + 1));
+            mSizes.assign(capacity + 1, 0);
+            mBlocks.assign((capacity >> kBlockBits) + 2, 0);
+            mClock = 0;
+            for (size_t index : slotByStamp)
+            {
+                if (index == none)
+                    continue;
+                KeyTable::Slot &slot = mTable.slot(index);
+                slot.stamp = ++mClock;
+                mSizes[mClock] = slot.size;
+                mBlocks[(mClock >> kBlockBits) + 1] += slot.size;
+            }
+            for (uint64_t block = 1; block < mBlocks.size(); ++block) // O(n) build
+            {
+                uint64_t parent = block + (block & (~block + 1));
+                if (parent < mBlocks.size())
+                    mBlocks[parent] += mBlocks[block];
+            }
+        }
+
+    public:
+        RecencyStack()
+        {
+            renumber();
+        }
+
+        /**
+         * @brief update key now has size bytes and is the most recent
+         * @return its byte reuse distance, -1 on its first update (or the first after a remove)
+         */
+        int64_t update(uint64_t key, int64_t size)
+        {
+            int64_t distance = -1;
+            KeyTable::Slot *slot = mTable.find(key);
+            if (slot)
+            {
+                if (!slot->removed)
+                    distance = after(slot->stamp) + slot->size;
+                slot->removed = false;
+                add(slot->stamp, -slot->size);
+                mTotalBytes -= slot->size;
+                slot->size = 0; // renumber below must not count it again
+            }
+
+            if (mClock + 1 >= mSizes.size())
+            {
+                renumber();
+                slot = mTable.find(key); // renumber does not move slots, insert below may
+            }
+            if (!slot)
+                slot = mTable.insert(key);
+            slot->stamp = ++mClock;
+            slot->size = size;
+            add(mClock, size);
+            mTotalBytes += size;
+            return distance;
+        }
+
+        /**
+         * @brief remove key misses on its next update. Its bytes stay in the stack until then: the keys it pushed
+         * out of a cache do not come back when it goes, so the keys updated before it keep counting them
+         * (a cache that had not dropped them yet gets the room back, hence an upper bound of their distance).
+         */
+        void remove(uint64_t key)
+        {
+            KeyTable::Slot *slot = mTable.find(key);
+            if (slot)
+                slot->removed = true;
+        }
+
+        size_t keys() const
+        {
+            return mTable.keys();
+        }
+    };
+
+    /**
+     * @brief DistanceHistogram updates and their bytes by reuse distance: one bucket per distance below
+     * 2^precision, then 2^precision buckets per power of two (1.6% wide at most with 6)
+     */
+    class DistanceHistogram
+    {
+    private:
+        int mPrecision;
+        std::vector<uint64_t> mCount;
+        std::vector<uint64_t> mBytes;
+
+    public:
+        uint64_t coldCount = 0; // first updates: misses at any size
+        uint64_t coldBytes = 0;
+
+        explicit DistanceHistogram(int precision)
+            : mPrecision(precision), mCount(static_cast<size_t>(65 - precision) << precision, 0), mBytes(mCount.size(), 0)
+        { }
+
+        size_t bucket(uint64_t distance) const
+        {
+            if (distance < (uint64_t(1) << mPrecision))
+                return distance;
+            int e = 63 - __builtin_clzll(distance);
+            return (static_cast<size_t>(e - mPrecision + 1) << mPrecision)
+                   + ((distance >> (e - mPrecision)) - (uint64_t(1) << mPrecision));
+        }
+
+        // largest distance of a bucket: a cache of that many bytes hits all the bucket
+        uint64_t last(size_t index) const
+        {
+            if (index < (size_t(1) << mPrecision))
+                return index;
+            size_t k = index >> mPrecision;
+            uint64_t m = index & ((size_t(1) << mPrecision) - 1);
+            uint64_t width = uint64_t(1) << (k - 1);
+            return ((uint64_t(1) << mPrecision) + m) * width + (width - 1);
+        }
+
+        void add(int64_t distance, uint32_t size)
+        {
+            if (distance < 0)
+            {
+                coldCount++;
+                coldBytes += size;
+                return;
+            }
+            size_t index = bucket(static_cast<uint64_t>(distance));
+            mCount[index]++;
+            mBytes[index] += size;
+        }
+
+        // rows of the curve, sizes from minBytes to maxBytes where it changes
+        void print(FILE *out, uint64_t minBytes, uint64_t maxBytes) const
+        {
+            double totalCount = static_cast<double>(coldCount);
+            double totalBytes = static_cast<double>(coldBytes);
+            for (size_t i = 0; i < mCount.size(); ++i)
+            {
+                totalCount += mCount[i];
+                totalBytes += mBytes[i];
+            }
+            if (totalCount == 0)
+                return;
+
+            uint64_t hitCount = 0;
+            uint64_t hitBytes = 0;
+            fprintf(out, "cache_bytes,byte_hit_ratio,object_hit_ratio\n");
+            for (size_t i = 0; i < mCount.size() && last(i) <= maxBytes; ++i)
+            {
+                hitCount += mCount[i];
+                hitBytes += mBytes[i];
+                if (last(i) >= minBytes && (mCount[i] || last(i) == minBytes))
+                    fprintf(out, "%llu,%.6f,%.6f\n", static_cast<unsigned long long>(last(i)),
+                            hitBytes / totalBytes, hitCount / totalCount);
+            }
+        }
+    };
+
+    void usage(const char *pName)
+    {
+        fprintf(stderr, "usage: %s [--precision 6] [--min BYTES] [--max BYTES] TRACE|-\n", pName);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int precision = 6;
+    uint64_t minBytes = 0;
+    uint64_t maxBytes = std::numeric_limits<uint64_t>::max();
+    const char *pPath = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--precision" && i + 1 < argc)
+            precision = atoi(argv[++i]);
+        else if (arg == "--min" && i + 1 < argc)
+            minBytes = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--max" && i + 1 < argc)
+            maxBytes = strtoull(argv[++i], nullptr, 10);
+        else if (!pPath && (arg == "-" || arg[0] != '-'))
+            pPath = argv[i];
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!pPath || precision < 0 || precision > 16)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    FILE *in = strcmp(pPath, "-") == 0 ? stdin : fopen(pPath, "rb");
+    if (!in)
+    {
+        fprintf(stderr, "cannot open %s: %s\n", pPath, strerror(errno));
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    RecencyStack stack;
+    DistanceHistogram histogram(precision);
+    std::vector<TraceRecord> records(1 << 16);
+    uint64_t updates = 0;
+    uint64_t removes = 0;
+    size_t read;
+    while ((read = fread(records.data(), sizeof(TraceRecord), records.size(), in)) > 0)
+    {
+        for (size_t i = 0; i < read; ++i)
+        {
+            const TraceRecord &record = records[i];
+            if (record.op == OpRemove)
+            {
+                stack.remove(record.key);
+                removes++;
+            }
+            else
+            {
+                histogram.add(stack.update(record.key, record.size), record.size);
+                updates++;
+            }
+        }
+    }
+    bool failed = ferror(in);
+    if (in != stdin)
+        fclose(in);
+    if (failed)
+    {
+        fprintf(stderr, "cannot read %s\n", pPath);
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%llu updates, %llu removes, %zu keys, %.1f s (%.0f ns/update)\n",
+            static_cast<unsigned long long>(updates), static_cast<unsigned long long>(removes), stack.keys(),
+            seconds, updates ? seconds * 1e9 / updates : 0.0);
+    histogram.print(stdout, minBytes, maxBytes);
+    return 0;
+}